@@ -1,10 +1,14 @@
 /*
-    base_orthonormalization - v2.1.0
+    base_orthonormalization - v2.5.0
     Makes the orthogonalization of a set of vectors. The given vectors need to
     be linearly independent.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
 
     History:
+        v2.5.0  Blocked Householder QR replaces Gram-Schmidt, threads argument
+        v2.4.0  Output format argument
+        v2.3.0  No symbolic argument
+        v2.2.0  Heap-allocated basis of any size read by la_read_matrix_d()
         v2.1.0  Doubly precision
         v2.0.0  Printing precision argument and remove last space in output
         v1.0.3  atof() replaces torfnum_atof()
@@ -28,6 +32,7 @@
 #include <stdlib.h>
 
 #include <math.h>
+#include <float.h>
 
 #include <getopt.h>
 
@@ -36,44 +41,72 @@
 #include "linear_algebra.h"
 
 
-void orthonormalization(basis, n, m)
+/* Orthonormalize the n vectors of dimension m in the rows of basis, as
+ * Gram-Schmidt would, by the Householder factorization basis = L*Q: Q is
+ * the new basis, its rows negated where L has a negative diagonal. Return
+ * -1 if the vectors are linearly dependent. */
+orthonormalization(basis, n, m, ldb, nthreads)
 double *basis;
 {
-    int i, j;
-    double inner_product, *u, *g;
+    int i;
+    double *tau, *sign, max;
 
+    if (n > m)
+        return -1;
+    tau = malloc(sizeof(double) * (n? n : 1));
+    sign = malloc(sizeof(double) * (n? n : 1));
+    la_gelqf_d(n, m, basis, ldb, tau, nthreads);
+    for (max=i=0; i < n; i++)
+        max = fmax(max, fabs(basis[(size_t)i*ldb + i]));
     for (i=0; i < n; i++) {
-        u = &basis[i*LA_SIZE];
-        for (j = i-1; j >= 0; j--) {
-            g = &basis[j*LA_SIZE];
-            inner_product = cblas_ddot(m, u, 1, g, 1);
-            cblas_daxpy(m, -inner_product, g, 1, u, 1);
+        sign[i] = basis[(size_t)i*ldb + i] < 0? -1 : 1;
+        if (!(fabs(basis[(size_t)i*ldb + i]) > m * DBL_EPSILON * max)) {
+            free(tau), free(sign);
+            return -1;
         }
-        inner_product = cblas_ddot(m, u, 1, u, 1);
-        cblas_dscal(m, 1/sqrt(inner_product), u, 1);
     }
+    la_orglq_d(n, m, basis, ldb, tau, nthreads);
+    for (i=0; i < n; i++)
+        if (sign[i] < 0)
+            cblas_dscal(m, -1.0, &basis[(size_t)i*ldb], 1);
+    free(tau), free(sign);
+    return 0;
 }
 
 main(argc, argv)
 char *argv[];
 {
-    double basis[LA_SIZE*LA_SIZE] = { 0 };
-    int n, len, m;
-    char *line, *p;
-    size_t size;
-    
+    la_matrix_d basis;
+    int ret;
+
     struct option long_opts[] = {
         {"help", no_argument, NULL, 'h'},
+        {"no-symbolic", no_argument, NULL, 'n'},
+        {"output-format", required_argument, NULL, 'o'},
         {"precision", required_argument, NULL, 'p'},
+        {"threads", required_argument, NULL, 't'},
         { 0 },
     };
     int opt;
+    int arg_threads = la_nprocs();
 
-    for (; (opt = getopt_long(argc, argv, "p:", long_opts, NULL)) != -1;)
+    for (; (opt = getopt_long(argc, argv, "no:p:t:", long_opts, NULL)) != -1;)
         switch (opt) {
+        case 'n':
+            la_arg_symbolic = 0;
+            break;
+        case 'o':
+            if (la_parse_output_format(optarg)) {
+                fprintf(stderr, "base_orthonormalization: invalid output format '%s'.\n", optarg);
+                return 2;
+            }
+            break;
         case 'p':
             la_arg_precision = atoi(optarg);
             break;
+        case 't':
+            arg_threads = atoi(optarg);
+            break;
         case '?':
             fputs("Try 'base_orthonormalization --help' for more information.\n", stderr);
             return 2;
@@ -81,22 +114,25 @@ char *argv[];
             fputs("Usage: base_orthonormalization [OPTION]\n"
                   "Makes the orthogonalization of a set of vectors. The given vectors need to be\n"
                   "linearly independent.\n\n"
-                  "The vectors are read from standard input.\n\n"
-                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n",
+                  "The vectors are read from standard input, one per line, and orthonormalized\n"
+                  "by a blocked Householder QR factorization.\n\n"
+                  "  -n, --no-symbolic  print numbers without looking for known constants\n"
+                  "  -o, --output-format=FORMAT\n"
+                  "                     write matrices as text or bin (NumPy .npy), default is text\n"
+                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n"
+                  "  -t, --threads=NUM  number of threads, default is the number of online\n"
+                  "                     processors\n",
                   stdout);
             return 0;
         }
 
-    line = NULL;
-    n = m = 0;
-    while (getline(&line, &size, stdin) != EOF) {
-        len = 0;
-        for (p=strtok(line, " "); p; p = strtok(NULL, " "))
-            basis[n * LA_SIZE + len++] = atof(p);
-        if (len > m)
-            m = len;
-        n++;
-    }
-    orthonormalization(basis, n, m);
-    la_show_matrix_d(stdout, basis, n, m, LA_SIZE);
+    la_allocate_matrix_d(&basis, 0, 0);
+    la_read_matrix_d(stdin, &basis);
+    if ((ret = orthonormalization(basis.base, basis.rows, basis.cols,
+                                  basis.lda, arg_threads)))
+        fputs("base_orthonormalization: the vectors are linearly dependent.\n", stderr);
+    else
+        la_show_matrix_d(stdout, basis.base, basis.rows, basis.cols, basis.lda);
+    la_free_matrix_d(&basis);
+    return ret? 1 : 0;
 }
@@ -0,0 +1,139 @@
+/*
+    bench_gemm - v1.0.0
+    Compares the GFLOP/s of the built-in GEMM of linear_algebra.c with the
+    system CBLAS.
+    Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
+
+    History:
+        v1.0.0  First version
+
+    bench_gemm is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or any later version.
+
+    This program is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <math.h>
+
+#include <getopt.h>
+
+#include "linear_algebra.h"
+
+
+double seconds()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void fill(m)
+la_matrix_d *m;
+{
+    int i, j;
+
+    for (i=0; i < m->rows; i++)
+        for (j=0; j < m->cols; j++)
+            LA_AT(m, i, j) = (double)rand() / RAND_MAX - .5;
+}
+
+/* Best GFLOP/s of C = A*op(B) over about a tenth of a second of runs. */
+double gflops(blas, trans_b, a, b, c)
+la_matrix_d *a, *b, *c;
+{
+    double t, best, start;
+
+    la_arg_blas = blas;
+    best = HUGE_VAL;
+    start = seconds();
+    do {
+        t = seconds();
+        la_gemm_d(trans_b, c->rows, c->cols, a->cols, 1.0, a->base, a->lda,
+                  b->base, b->lda, 0.0, c->base, c->lda);
+        t = seconds() - t;
+        if (t < best)
+            best = t;
+    } while (seconds() - start < .1);
+    return 2.0 * c->rows * c->cols * a->cols / best / 1e9;
+}
+
+/* Time m x k by k x n products with both GEMMs and print the largest
+ * difference between their results. */
+void bench(m, n, k, trans_b)
+{
+    la_matrix_d a, b, c, d;
+    double system, internal, diff;
+    int i, j;
+
+    la_allocate_matrix_d(&a, m, k);
+    if (trans_b)
+        la_allocate_matrix_d(&b, n, k);
+    else
+        la_allocate_matrix_d(&b, k, n);
+    la_allocate_matrix_d(&c, m, n);
+    la_allocate_matrix_d(&d, m, n);
+    fill(&a);
+    fill(&b);
+    system = gflops(LA_BLAS_SYSTEM, trans_b, &a, &b, &c);
+    internal = gflops(LA_BLAS_INTERNAL, trans_b, &a, &b, &d);
+    for (diff=i=0; i < m; i++)
+        for (j=0; j < n; j++)
+            if (fabs(LA_AT(&c, i, j) - LA_AT(&d, i, j)) > diff)
+                diff = fabs(LA_AT(&c, i, j) - LA_AT(&d, i, j));
+    printf("%5d %5d %5d %c %9.2lf %9.2lf %9.1le\n", m, n, k, trans_b? 'T' : 'N',
+           system, internal, diff);
+    la_free_matrix_d(&a);
+    la_free_matrix_d(&b);
+    la_free_matrix_d(&c);
+    la_free_matrix_d(&d);
+}
+
+main(argc, argv)
+char *argv[];
+{
+    struct option long_opts[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"size", required_argument, NULL, 's'},
+        { 0 },
+    };
+    int opt, n;
+    int arg_size = 1024;
+
+    for (; (opt = getopt_long(argc, argv, "s:", long_opts, NULL)) != -1;)
+        switch (opt) {
+        case 's':
+            arg_size = atoi(optarg);
+            break;
+        case '?':
+            fputs("Try 'bench_gemm --help' for more information.\n", stderr);
+            return 2;
+        case 'h':
+            fputs("Usage: bench_gemm [OPTION]...\n"
+                  "Compares the GFLOP/s of the built-in GEMM of linear_algebra.c with the\n"
+                  "system CBLAS, on square and skinny shapes.\n\n"
+                  "  -s, --size=NUM     largest dimension, default is 1024\n",
+                  stdout);
+            return 0;
+        }
+
+    printf("microkernel: %s\n", la_gemm_kernel_name());
+    puts("    m     n     k B    system  internal  max diff");
+    for (n=64; n <= arg_size; n <<= 1)
+        bench(n, n, n, 0);
+    bench(arg_size, arg_size, arg_size, 1);
+    bench(arg_size, arg_size, 16, 0);
+    bench(arg_size, 16, arg_size, 0);
+    bench(16, arg_size, arg_size, 0);
+    bench(1, arg_size, arg_size, 0);
+    bench(arg_size, 1, arg_size, 1);
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+    bench_read - v1.0.0
+    Measures the throughput of the matrix readers of linear_algebra.c.
+    Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
+
+    History:
+        v1.0.0  First version
+
+    bench_read is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or any later version.
+
+    This program is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <getopt.h>
+
+#include "linear_algebra.h"
+
+
+double seconds()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Write a matrix of random numbers with cols columns and about mb megabytes. */
+long write_matrix(fp, mb, cols)
+FILE *fp;
+{
+    long bytes;
+    int j;
+
+    for (bytes=0; bytes < mb * 1000000L;)
+        for (j=0; j < cols; j++)
+            bytes += fprintf(fp, j < cols-1? "%.*f " : "%.*f\n", rand() % 10,
+                             (rand() - RAND_MAX/2) / 1e3);
+    return bytes;
+}
+
+/* What the readers did before la_strtod(). */
+void read_strtok(stream, m)
+FILE *stream;
+la_matrix_d *m;
+{
+    char *line, *p;
+    size_t size;
+    int j;
+
+    m->rows = m->cols = 0;
+    size = 0;
+    line = NULL;
+    while (getline(&line, &size, stream) != EOF) {
+        la_resize_matrix_d(m, m->rows+1, m->cols);
+        for (j=0, p=strtok(line, " "); p; p = strtok(NULL, " "), j++) {
+            if (j == m->cols)
+                la_resize_matrix_d(m, m->rows, j+1);
+            LA_AT(m, m->rows-1, j) = atof(p);
+        }
+    }
+    free(line);
+}
+
+main(argc, argv)
+char *argv[];
+{
+    FILE *fp;
+    la_matrix_d m;
+    long bytes;
+    double t;
+
+    struct option long_opts[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"cols", required_argument, NULL, 'c'},
+        {"size", required_argument, NULL, 's'},
+        { 0 },
+    };
+    int opt;
+    int arg_cols = 1000;
+    int arg_size = 300;
+
+    for (; (opt = getopt_long(argc, argv, "c:s:", long_opts, NULL)) != -1;)
+        switch (opt) {
+        case 'c':
+            arg_cols = atoi(optarg);
+            break;
+        case 's':
+            arg_size = atoi(optarg);
+            break;
+        case '?':
+            fputs("Try 'bench_read --help' for more information.\n", stderr);
+            return 2;
+        case 'h':
+            fputs("Usage: bench_read [OPTION]...\n"
+                  "Measures the throughput of the matrix readers of linear_algebra.c.\n\n"
+                  "  -c, --cols=NUM     columns of the matrix, default is 1000\n"
+                  "  -s, --size=MB      size of the matrix file in megabytes, default is 300\n",
+                  stdout);
+            return 0;
+        }
+
+    if (!(fp = tmpfile())) {
+        perror("bench_read");
+        return 1;
+    }
+    bytes = write_matrix(fp, arg_size, arg_cols);
+    la_allocate_matrix_d(&m, 0, 0);
+
+    rewind(fp);
+    t = seconds();
+    read_strtok(fp, &m);
+    t = seconds() - t;
+    printf("strtok+atof:     %d x %d, %.1lf MB/s\n", m.rows, m.cols, bytes / t / 1e6);
+
+    rewind(fp);
+    t = seconds();
+    la_read_matrix_d(fp, &m);
+    t = seconds() - t;
+    printf("la_read_matrix_d: %d x %d, %.1lf MB/s\n", m.rows, m.cols, bytes / t / 1e6);
+
+    la_free_matrix_d(&m);
+    fclose(fp);
+    return 0;
+}
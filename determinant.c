@@ -1,9 +1,16 @@
 /*
-    determinant - v1.1.0
+    determinant - v2.4.0
     Find the determinant of a matrix.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
 
     History:
+        v2.4.0  Task-graph tiled LU with threads
+        v2.3.0  Out-of-core LU with scratch and tile arguments
+        v2.2.0  Batch argument with closed-form determinants up to 4 x 4
+        v2.1.0  Output format argument
+        v2.0.0  LU factorization with partial pivoting replaces the permutation
+                sum and log argument
+        v1.2.0  Heap-allocated matrix of any size
         v1.1.0  Printing precision argument
         v1.0.1  stream argument in la_read_one_pointer_matrix_d
         v1.0.0  First version
@@ -22,76 +29,169 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <math.h>
+
 #include <getopt.h>
 
 #include "linear_algebra.h"
 
 
-double determinant(m, rows, cols)
-double m[][LA_SIZE];
+/* exp() of numbers beyond it may overflow or lose precision. */
+#define LOG_DBL_RANGE 700
+
+/* Return log|det(m)| and set sign, m is overwritten with its LU factors,
+ * found by nthreads threads on tiles of tile columns. */
+double determinant(m, tile, nthreads, sign)
+la_matrix_d *m;
+int *sign;
+{
+    int *ipiv;
+    double log_det;
+
+    ipiv = malloc(sizeof(int) * (m->rows? m->rows : 1));
+    la_getrf_dag_d(m->rows, m->cols, m->base, m->lda, ipiv, tile, nthreads);
+    log_det = la_log_det_d(m->rows, m->base, m->lda, ipiv, sign);
+    free(ipiv);
+    return log_det;
+}
+
+/* Out of the range of double, the determinant is printed as mantissa and
+ * power of ten. */
+void print_determinant(sign, log_det, precision)
+double log_det;
 {
-    int p[LA_SIZE+1];
-    int k_indexes[LA_SIZE];
-    int i, j, k;
-
-    double det = 0, prod;
-    int sig = -1;
-
-    /* Do first iteration of the summation */
-    for (prod=m[0][0], k=1; k < cols; k++)
-        prod *= m[k][k];
-    det += prod;
-    
-    /* Regressive QuickPerm */
-    for (i=0; i < cols; i++) {
-        k_indexes[i] = i;
-        p[i] = i;
+    double e10, ex;
+
+    if (!sign)
+        printf("%.*lf\n", precision, 0.);
+    else if (fabs(log_det) < LOG_DBL_RANGE)
+        printf("%.*lf\n", precision, sign * exp(log_det));
+    else {
+        e10 = log_det / M_LN10;
+        ex = floor(e10);
+        printf("%.*lfe%+.0lf\n", precision, sign * pow(10, e10 - ex), ex);
     }
-    p[i] = i;
-    i=1;
-    while (i < cols) {
-        p[i]--;
-        j = i%2? p[i] : 0;
-        
-        /* Swap */
-        k_indexes[i] ^= k_indexes[j];
-        k_indexes[j] ^= k_indexes[i];
-        k_indexes[i] ^= k_indexes[j];
-        
-        /* Do one iteration of the summation */
-        for (prod=m[0][k_indexes[0]], k=1; k < cols; k++)
-            prod *= m[k][k_indexes[k]];
-        det += sig*prod;
-        sig *= -1;
-
-        i = 1;
-        while (!p[i]) {
-            p[i] = i;
-            i++;
-        }
+}
+
+/* Matrices of a text stream evaluated at a time by batch(). */
+#define DET_BATCH 4096
+
+/* Print, or keep for one binary column, the determinants of the batch b.
+ * ndet counts the kept ones, so text reuses det for every batch. */
+static void flush(b, det, ndet, precision)
+la_batch_d *b;
+double **det;
+size_t *ndet;
+{
+    size_t p;
+
+    *det = realloc(*det, sizeof(double) * (*ndet + b->count + 1));
+    la_det_batch_d(b->count, b->n, b->base, b->lda, b->stride, *det + *ndet);
+    if (la_arg_binary)
+        *ndet += b->count;
+    else
+        for (p=0; p < b->count; p++)
+            printf("%.*lf\n", precision, (*det)[p]);
+}
+
+/* Determinants of a stream of square matrices separated by lines "e", or of
+ * NumPy arrays of n x n matrices stacked by rows, one per line. Matrices of
+ * the same size in a row are evaluated together. */
+batch(precision)
+{
+    la_batch_d b;
+    double *det;
+    size_t ndet;
+    int count;
+
+    la_allocate_batch_d(&b, DET_BATCH);
+    det = NULL;
+    ndet = 0;
+    while ((count = la_read_batch_d(stdin, &b)) > 0)
+        flush(&b, &det, &ndet, precision);
+    /* One column with every determinant. */
+    if (!count && la_arg_binary)
+        la_show_matrix_d(stdout, det, ndet, 1, 1);
+    free(det);
+    la_free_batch_d(&b);
+    return count < 0;
+}
+
+/* Panel width of the out-of-core LU, unless set by --tile. In memory, the
+ * tiles are LA_TILE. */
+#define OOC_TILE 1024
+
+/* Return log|det| of the matrix read out of core into the scratch file, 2 if
+ * it could not be read. */
+double ooc_determinant(scratch, tile, nthreads, sign)
+char *scratch;
+int *sign;
+{
+    la_ooc_d f;
+    double log_det;
+
+    if (la_ooc_read_d(stdin, &f, scratch, tile? tile : OOC_TILE, 0, NULL)) {
+        *sign = 2;
+        return 0;
     }
-    return det;
+    la_ooc_getrf_d(&f, nthreads);
+    log_det = la_ooc_log_det_d(&f, sign);
+    la_free_ooc_d(&f);
+    return log_det;
 }
 
 main(argc, argv)
 char *argv[];
 {
-    double matrix[LA_SIZE][LA_SIZE];
-    int rows, cols;
+    la_matrix_d matrix;
+    double log_det, result[2];
+    int sign;
 
     struct option long_opts[] = {
+        {"batch", no_argument, NULL, 'b'},
         {"help", no_argument, NULL, 'h'},
+        {"log", no_argument, NULL, 'l'},
+        {"output-format", required_argument, NULL, 'o'},
         {"precision", required_argument, NULL, 'p'},
+        {"scratch", required_argument, NULL, 's'},
+        {"threads", required_argument, NULL, 't'},
+        {"tile", required_argument, NULL, 'T'},
         { 0 },
     };
     int opt;
     int arg_precision = 6;
+    int arg_log = 0;
+    int arg_batch = 0;
+    char *arg_scratch = NULL;
+    int arg_threads = la_nprocs();
+    int arg_tile = 0;
 
-    for (; (opt = getopt_long(argc, argv, "p:", long_opts, NULL)) != -1;)
+    for (; (opt = getopt_long(argc, argv, "blo:p:s:t:T:", long_opts, NULL)) != -1;)
         switch (opt) {
+        case 'b':
+            arg_batch = 1;
+            break;
+        case 'l':
+            arg_log = 1;
+            break;
+        case 'o':
+            if (la_parse_output_format(optarg)) {
+                fprintf(stderr, "determinant: invalid output format '%s'.\n", optarg);
+                return 2;
+            }
+            break;
         case 'p':
             arg_precision = atoi(optarg);
             break;
+        case 's':
+            arg_scratch = optarg;
+            break;
+        case 't':
+            arg_threads = atoi(optarg);
+            break;
+        case 'T':
+            arg_tile = atoi(optarg);
+            break;
         case '?':
             fputs("Try 'determinant --help' for more information.\n", stderr);
             return 2;
@@ -104,11 +204,48 @@ char *argv[];
                   ". . . ...\n"
                   ". . . ...\n"
                   ". . . ...\n\n"
+                  "  -b, --batch        determinants of many matrices, one per line: separated\n"
+                  "                     by lines \"e\", or n x n matrices stacked by rows in\n"
+                  "                     NumPy arrays\n"
+                  "  -l, --log          print the sign and the natural logarithm of the absolute\n"
+                  "                     value of the determinant\n"
+                  "  -o, --output-format=FORMAT\n"
+                  "                     write matrices as text or bin (NumPy .npy), default is text\n"
                   "  -p, --precision    printing precision of floating-point numbers, default is 6\n"
+                  "  -s, --scratch=FILE LU factorization out of core, with the matrix in FILE,\n"
+                  "                     for matrices larger than memory\n"
+                  "  -t, --threads=NUM  threads of the LU factorization, default is the number of\n"
+                  "                     online processors\n"
+                  "  -T, --tile=NUM     order of the tiles of the LU factorization, default is 256,\n"
+                  "                     or columns of the out-of-core panels, default is 1024;\n"
+                  "                     three panels are kept in memory\n"
                   , stdout);
             return 0;
         }
 
-    la_read_one_pointer_matrix_d(stdin, matrix, &rows, &cols);
-    printf("%.*lf\n", arg_precision, determinant(matrix, rows, cols));
+    if (arg_batch)
+        return batch(arg_precision);
+    la_allocate_matrix_d(&matrix, 0, 0);
+    if (arg_scratch) {
+        log_det = ooc_determinant(arg_scratch, arg_tile, arg_threads, &sign);
+        if (sign == 2)
+            return 1;
+    } else {
+        la_read_matrix_d(stdin, &matrix);
+        if (matrix.rows != matrix.cols) {
+            fputs("determinant: the matrix is not square.\n", stderr);
+            return 1;
+        }
+        log_det = determinant(&matrix, arg_tile, arg_threads, &sign);
+    }
+    if (la_arg_binary) {
+        /* A 1 x 1 matrix, or 1 x 2 with the sign and the logarithm. */
+        result[0] = arg_log? sign : sign? sign * exp(log_det) : 0;
+        result[1] = log_det;
+        la_show_matrix_d(stdout, result, 1, arg_log? 2 : 1, 2);
+    } else if (arg_log)
+        printf("%d %.*lf\n", sign, arg_precision, log_det);
+    else
+        print_determinant(sign, log_det, arg_precision);
+    la_free_matrix_d(&matrix);
 }
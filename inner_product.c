@@ -1,11 +1,18 @@
 /*
-    inner_product - v2.1.0
+    inner_product - v2.7.0
     Calculates the inner product, norm and distance between two
     vectors/matrices. If the input is two vectors it calculates the cosine of
     the angle beetwen them too.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
     
     History:
+        v2.7.0  Frobenius inner product kernel replaces GEMM and trace, threads
+                argument instead of the BLAS one
+        v2.6.0  Fused single-pass vector metrics and stream argument
+        v2.5.0  BLAS argument, built-in or system GEMM
+        v2.4.0  Output format argument
+        v2.3.0  No symbolic argument
+        v2.2.0  Heap-allocated matrices of any size
         v2.1.0  Doubly precision
         v2.0.0  Printing precision argument and remove last space in output
         v1.0.1  stream and lda arguments in la_read_matrics_s and la_show_matrix_s
@@ -29,91 +36,113 @@
 
 #include <getopt.h>
 
-#include "cblas.h"
-
 #include "linear_algebra.h"
 
 
-double cos_angle_sx_sy(n, sx, incx, sy, incy)
-double sx[], sy[];
-{
-    double inner_product;
-    double normx, normy;
-
-    inner_product = cblas_ddot(n, sx, incx, sy, incy);
-    normx = sqrt(cblas_ddot(n, sx, incx, sx, incx));
-    normy = sqrt(cblas_ddot(n, sy, incy, sy, incy));
-    return inner_product / (normx * normy);
-}
-
-double matrix_eq_inner_product(m, n, a, lda)
-double a[];
-{
-    int i, j;
-    double sum;
-
-    for (sum=i=0; i < m; i++)
-        for (j=0; j < n; j++)
-            sum += a[i * lda + j] * a[i * lda + j];
-    return sum;
-}
+/* Elements of each vector read at a time by --stream. */
+#define CHUNK 65536
 
 double distance_matrices(m, k, a, lda, b, ldb)
 double a[], b[];
 {
-    int i, j;
-    
-    for (i=0; i < m; i++)
-        for (j=0; j < k; j++)
-            a[i * lda + j] = a[i * lda + j] - b[i * ldb + j];
-    return sqrt(matrix_eq_inner_product(m, k, a, lda));
-}
+    int i;
+    double sums[4];
 
-double distance_vectors(n, sx, incx, sy, incy)
-double sx[], sy[];
-{
-    double *sz, dist;
-
-    sz = malloc(sizeof(double) * n);
-    cblas_dcopy(n, sx, incx, sz, 1);
-    cblas_daxpy(n, -1.f, sy, incy, sz, 1);
-    dist = sqrt(cblas_ddot(n, sz, 1, sz, 1));
-    free(sz);
-    return dist;
+    memset(sums, 0, sizeof(sums));
+    for (i=0; i < m; i++)
+        la_vector_sums_d(k, &a[(size_t)i * lda], &b[(size_t)i * ldb], sums);
+    return sqrt(sums[3]);
 }
 
-double matrix_inner_product(m, n, k, a, lda, b, ldb)
-double a[], b[];
+/* Add the sums of la_vector_sums_d() of the vectors in the first two lines
+ * of stream, or of the first one with itself, reading a chunk at a time: a
+ * second handle on the file reads the second vector along the first one.
+ * Return the number of vectors, or -1 on error. */
+stream_sums(stream, sums)
+FILE *stream;
+double *sums;
 {
-    int i;
-    double c[LA_SIZE * LA_SIZE], tr;
-
-    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, m, n, k, 1.f, a, lda, b, ldb, 1.f, c, LA_SIZE);
-    for (tr=i=0; i < n; i++)
-        tr += c[i * LA_SIZE + i];
-    return tr;
+    FILE *second;
+    char path[32];
+    double *x, *y;
+    long start;
+    int nx, ny, nvec;
+
+    la_peek(stream);
+    snprintf(path, sizeof(path), "/dev/fd/%d", fileno(stream));
+    if ((start = ftell(stream)) < 0 || !(second = fopen(path, "r"))) {
+        fputs("inner_product: --stream needs the input from a file.\n", stderr);
+        return -1;
+    }
+    x = malloc(sizeof(double) * CHUNK);
+    y = malloc(sizeof(double) * CHUNK);
+    while (la_read_vector_chunk_d(stream, x, CHUNK) == CHUNK)
+        ;
+    /* The vectors may be apart by a line "e". */
+    if (la_peek(stream) == 'e')
+        while ((nx = getc(stream)) != EOF && nx != '\n')
+            ;
+    nvec = la_peek(stream) == EOF? 1 : 2;
+    fseek(second, nvec == 2? ftell(stream) : start, SEEK_SET);
+    fseek(stream, start, SEEK_SET);
+    do {
+        nx = la_read_vector_chunk_d(stream, x, CHUNK);
+        ny = la_read_vector_chunk_d(second, y, CHUNK);
+        if (nx != ny) {
+            fputs("inner_product: the vectors have different sizes.\n", stderr);
+            nvec = -1;
+            break;
+        }
+        la_vector_sums_d(nx, x, y, sums);
+    } while (nx == CHUNK);
+    fclose(second);
+    free(x), free(y);
+    return nvec;
 }
 
 main(argc, argv)
 char *argv[];
 {
-    double a[LA_SIZE*LA_SIZE], b[LA_SIZE*LA_SIZE];
-    double inner_product, distance;
-    int arows, acols;
-    int brows, bcols;
+    la_matrix_d ma, mb;
+    double *a, *b;
+    double inner_product, distance, results[4], sums[4];
+    int nresults, nvec;
+    int arows, acols, lda;
+    int brows, bcols, ldb;
 
     struct option long_opts[] = {
         {"help", no_argument, NULL, 'h'},
+        {"no-symbolic", no_argument, NULL, 'n'},
+        {"output-format", required_argument, NULL, 'o'},
         {"precision", required_argument, NULL, 'p'},
+        {"stream", no_argument, NULL, 's'},
+        {"threads", required_argument, NULL, 't'},
         { 0 },
     };
     int opt;
+    int arg_stream = 0;
+    int arg_threads = la_nprocs();
 
-    for (; (opt = getopt_long(argc, argv, "p:", long_opts, NULL)) != -1;)
+    for (; (opt = getopt_long(argc, argv, "no:p:st:", long_opts, NULL)) != -1;)
         switch (opt) {
+        case 'n':
+            la_arg_symbolic = 0;
+            break;
+        case 'o':
+            if (la_parse_output_format(optarg)) {
+                fprintf(stderr, "inner_product: invalid output format '%s'.\n", optarg);
+                return 2;
+            }
+            break;
         case 'p':
             la_arg_precision = atoi(optarg);
             break;
+        case 's':
+            arg_stream = 1;
+            break;
+        case 't':
+            arg_threads = atoi(optarg);
+            break;
         case '?':
             fputs("Try 'inner_product --help' for more information.\n", stderr);
             return 2;
@@ -123,33 +152,81 @@ char *argv[];
                   "vectors/matrices. If the input is two vectors it calculates the cosine of\n"
                   "the angle beetwen them too.\n\n"
                   "The matrices/vectors are read from standard input.\n\n"
-                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n",
+                  "  -n, --no-symbolic  print numbers without looking for known constants\n"
+                  "  -o, --output-format=FORMAT\n"
+                  "                     write matrices as text or bin (NumPy .npy), default is text\n"
+                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n"
+                  "  -s, --stream       read two vectors from a file a chunk at a time, in\n"
+                  "                     constant memory, and print only the results\n"
+                  "  -t, --threads=NUM  number of threads for matrices, default is the number of\n"
+                  "                     online processors\n",
                   stdout);
             return 0;
         }
 
-    brows = arows = 0;
-    la_read_matrices_d(stdin, a, &arows, &acols, LA_SIZE);
-    la_read_matrices_d(stdin, b, &brows, &bcols, LA_SIZE);
-    puts(arows < 2 && brows < 2? "Vectors:" : "Matrices:");
-    la_show_matrix_d(stdout, a, arows, acols, LA_SIZE);
-    la_show_matrix_d(stdout, b, brows, bcols, LA_SIZE);
+    la_allocate_matrix_d(&ma, 0, 0);
+    la_allocate_matrix_d(&mb, 0, 0);
+    memset(sums, 0, sizeof(sums));
+    /* NumPy input is mapped, not read, so it is not streamed. */
+    if (arg_stream && la_peek(stdin) != 0x93) {
+        if ((nvec = stream_sums(stdin, sums)) < 0)
+            return 1;
+        arows = 1, brows = nvec - 1;
+    } else {
+        la_read_matrix_d(stdin, &ma);
+        la_read_matrix_d(stdin, &mb);
+        a = ma.base, arows = ma.rows, acols = ma.cols, lda = ma.lda;
+        b = mb.base, brows = mb.rows, bcols = mb.cols, ldb = mb.lda;
+        if (!la_arg_binary && !arg_stream) {
+            puts(arows < 2 && brows < 2? "Vectors:" : "Matrices:");
+            la_show_matrix_d(stdout, a, arows, acols, lda);
+            la_show_matrix_d(stdout, b, brows, bcols, ldb);
+        }
+        if (arows < 2 && brows < 2) {
+            if (brows && bcols != acols) {
+                fputs("inner_product: the vectors have different sizes.\n", stderr);
+                return 1;
+            }
+            la_vector_sums_d(acols, a, brows? b : a, sums);
+        } else if (brows && (brows != arows || bcols != acols)) {
+            fputs("inner_product: the matrices have different sizes.\n", stderr);
+            return 1;
+        }
+    }
+    nresults = 3;
     if (arows < 2 && brows < 2) {
-        inner_product = cblas_ddot(acols, a, 1, brows? b : a, 1);
-        distance = distance_vectors(acols, a, 1, brows? b : a, 1);
-        if (brows)
-            printf("Cosine of the angle between the vectors: %.*lf\n",
-                    la_arg_precision, cos_angle_sx_sy(acols, a, 1, b, 1));
+        inner_product = sums[0];
+        distance = sqrt(sums[3]);
+        if (brows) {
+            results[nresults++] = sums[0] / (sqrt(sums[1]) * sqrt(sums[2]));
+            if (!la_arg_binary)
+                printf("Cosine of the angle between the vectors: %.*lf\n",
+                        la_arg_precision, results[3]);
+        }
     } else if (brows) {
-        inner_product = matrix_inner_product(arows, bcols, acols, a, LA_SIZE, brows? b : a, LA_SIZE);
-        distance = distance_matrices(arows, acols, a, LA_SIZE, b, LA_SIZE);
+        inner_product = la_frobenius_d(arows, acols, a, lda, b, ldb,
+                                       arg_threads);
+        distance = distance_matrices(arows, acols, a, lda, b, ldb);
     } else {
-        inner_product = matrix_eq_inner_product(arows, acols, a, LA_SIZE);
+        /* <A, A> and trace(A*A^T) are the same sum. */
+        inner_product = la_frobenius_d(arows, acols, a, lda, a, lda, arg_threads);
         distance = 0;
-        printf("Other inner product: %.*lf\n", la_arg_precision,
-               matrix_inner_product(arows, acols, acols, a, LA_SIZE, a, LA_SIZE));
+        results[nresults++] = inner_product;
+        if (!la_arg_binary)
+            printf("Other inner product: %.*lf\n", la_arg_precision, results[3]);
+    }
+    if (la_arg_binary) {
+        /* One row: inner product, norm, distance and the cosine or the
+         * other inner product, when computed. */
+        results[0] = inner_product;
+        results[1] = sqrt(inner_product);
+        results[2] = distance;
+        la_show_matrix_d(stdout, results, 1, nresults, nresults);
+    } else {
+        printf("Inner product: %.*lf\n", la_arg_precision, inner_product);
+        printf("Norm: %.*lf\n", la_arg_precision, sqrt(inner_product));
+        printf("Distance: %.*lf\n", la_arg_precision, distance);
     }
-    printf("Inner product: %.*lf\n", la_arg_precision, inner_product);
-    printf("Norm: %.*lf\n", la_arg_precision, sqrt(inner_product));
-    printf("Distance: %.*lf\n", la_arg_precision, distance);
+    la_free_matrix_d(&ma);
+    la_free_matrix_d(&mb);
 }
@@ -1,9 +1,16 @@
 /*
-    inverse - v2.0.0
+    inverse - v3.4.0
     Finds the inverse of a given matrix.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
     
     History:
+        v3.4.0  Task-graph tiled LU with threads
+        v3.3.0  Batch argument with adjugate inverses up to 4 x 4
+        v3.2.0  Output format argument
+        v3.1.0  No symbolic argument
+        v3.0.0  Inverse from the LU factorization in place, threads and steps
+                argument for Gauss-Jordan elimination
+        v2.1.0  Heap-allocated matrix of any size
         v2.0.0  Printing precision argument and remove last space in output
         v1.0.1  Use la_read_matrices_d to read input matrix and pass stream
                 argument in la_show_matrix_d
@@ -28,75 +35,209 @@
 #include "linear_algebra.h"
 
 
-#define LDA (LA_SIZE<<1)
+/* Gauss-Jordan elimination of [M | I], printing every step. */
+void gauss_jordan_steps(m)
+la_matrix_d *m;
+{
+    double *matrix;
+    int rows, cols, lda;
+    int i,j,k;
+
+    rows = m->rows;
+    cols = m->cols;
+    la_resize_matrix_d(m, rows, cols<<1);
+    matrix = m->base;
+    lda = m->lda;
+    /* Concatenate with inverse: */
+    for (i=0; i < rows; i++)
+        for (j=0; j < cols; j++)
+            matrix[lda * i + j + cols] = i==j;
+    /* Only the inverse is written in binary. */
+    if (!la_arg_binary) {
+        puts("M and I:");
+        for (i=0; i < rows; i++, putchar('\n'))
+            for (j=0; j < cols<<1; j++)
+                printf("%.*f ", la_arg_precision, matrix[lda * i + j]);
+    }
+    for (k=0; k < rows; k++) {
+        /* Divide the row akj by akk. */
+        for (i=k+1; i < cols<<1; i++)
+            matrix[lda * k + i] /= matrix[lda * k + k];
+        /* Ensures akk equals to one. */
+        matrix[lda * k + k] = 1.f;
+        /* Subtract the next rows a(i=k+1)j by aik times akj. */
+        for (i=k+1; i < rows; i++) {
+            for (j=k+1; j < cols<<1; j++)
+                matrix[lda * i + j] -= matrix[lda * i + k] * matrix[lda * k + j];
+            /* Ensures that aik equals to zero. */
+            matrix[lda * i + k] = 0;
+        }
+        if (!la_arg_binary) {
+            printf("Step %0d:\n", k+1);
+            la_show_matrix_d(stdout, matrix, rows, cols, lda);
+        }
+    }
+    /* From the bottom up, subtract row akj times aik. */
+    for (k=rows-1; k > 0; k--)    
+        for (i=k-1; i >= 0; i--) {
+            for (j=k+1; j < cols<<1; j++)
+                matrix[lda * i + j] -= matrix[lda * k + j] * matrix[lda * i + k];
+            /* Guarantees aik equals to zero. */
+            matrix[lda * i + k] = 0;
+        }
+    if (!la_arg_binary) {
+        puts("M:");
+        la_show_matrix_d(stdout, matrix, rows, cols, lda);
+        puts("M^-1:");
+    }
+    la_show_matrix_d(stdout, &matrix[cols], rows, cols, lda);
+}
 
-double matrix[LA_SIZE*LDA];
+/* Matrices of a text stream inverted at a time by batch(). */
+#define INV_BATCH 4096
+
+/* Invert the matrices of the batch b and print them, apart by lines "e" and
+ * "singular" in place of a singular one; in binary, one array with the
+ * inverses stacked by rows, NaN for a singular one. shown counts the
+ * matrices printed. Return the number of singular ones. */
+static flush(b, shown)
+la_batch_d *b;
+int *shown;
+{
+    double *inv;
+    int p, n, nsingular, *singular;
+
+    n = b->n;
+    inv = malloc(sizeof(double) * ((size_t)b->count*n*n + 1));
+    singular = malloc(sizeof(int) * (b->count + 1));
+    la_inv_batch_d(b->count, n, b->base, b->lda, b->stride, inv, singular);
+    for (nsingular=p=0; p < b->count; p++)
+        nsingular += singular[p];
+    if (la_arg_binary)
+        la_show_matrix_d(stdout, inv, b->count*n, n, n);
+    else
+        for (p=0; p < b->count; p++, ++*shown) {
+            if (*shown)
+                puts("e");
+            if (singular[p])
+                puts("singular");
+            else
+                la_show_matrix_d(stdout, inv + (size_t)p*n*n, n, n, n);
+        }
+    free(inv), free(singular);
+    return nsingular;
+}
+
+/* Inverses of a stream of square matrices separated by lines "e", or of
+ * NumPy arrays of n x n matrices stacked by rows. Matrices of the same size
+ * in a row are inverted together. Return 1 if any is singular. */
+batch()
+{
+    la_batch_d b;
+    int count, shown, nsingular;
+
+    la_allocate_batch_d(&b, INV_BATCH);
+    shown = nsingular = 0;
+    while ((count = la_read_batch_d(stdin, &b)) > 0)
+        nsingular += flush(&b, &shown);
+    la_free_batch_d(&b);
+    if (count < 0)
+        return 1;
+    if (nsingular)
+        fprintf(stderr, "inverse: %d singular matrices.\n", nsingular);
+    return nsingular > 0;
+}
 
 main(argc, argv)
 char *argv[];
 {
-    int rows, cols;
-    int i,j,k;
+    la_matrix_d m;
+    int *ipiv, ret;
 
     struct option long_opts[] = {
+        {"batch", no_argument, NULL, 'b'},
         {"help", no_argument, NULL, 'h'},
+        {"no-symbolic", no_argument, NULL, 'n'},
+        {"output-format", required_argument, NULL, 'o'},
         {"precision", required_argument, NULL, 'p'},
+        {"steps", no_argument, NULL, 's'},
+        {"threads", required_argument, NULL, 't'},
         { 0 },
     };
     int opt;
+    int arg_steps = 0;
+    int arg_batch = 0;
+    int arg_threads = la_nprocs();
 
-    for (; (opt = getopt_long(argc, argv, "p:", long_opts, NULL)) != -1;)
+    for (; (opt = getopt_long(argc, argv, "bno:p:st:", long_opts, NULL)) != -1;)
         switch (opt) {
+        case 'b':
+            arg_batch = 1;
+            break;
+        case 'n':
+            la_arg_symbolic = 0;
+            break;
+        case 'o':
+            if (la_parse_output_format(optarg)) {
+                fprintf(stderr, "inverse: invalid output format '%s'.\n", optarg);
+                return 2;
+            }
+            break;
         case 'p':
             la_arg_precision = atoi(optarg);
             break;
+        case 's':
+            arg_steps = 1;
+            break;
+        case 't':
+            arg_threads = atoi(optarg);
+            break;
         case '?':
             fputs("Try 'inverse --help' for more information.\n", stderr);
             return 2;
         case 'h':
-            fputs("Usage: inverse [OPTION]\n"
+            fputs("Usage: inverse [OPTION]...\n"
                   "Finds the inverse of a given matrix.\n\n"
                   "The matrix is read from standard input.\n\n"
-                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n",
+                  "  -b, --batch        invert many matrices: separated by lines \"e\", or n x n\n"
+                  "                     matrices stacked by rows in NumPy arrays; the inverses\n"
+                  "                     are printed apart by lines \"e\", \"singular\" for a\n"
+                  "                     singular matrix\n"
+                  "  -n, --no-symbolic  print numbers without looking for known constants\n"
+                  "  -o, --output-format=FORMAT\n"
+                  "                     write matrices as text or bin (NumPy .npy), default is text\n"
+                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n"
+                  "  -s, --steps        use Gauss-Jordan elimination and print every step\n"
+                  "  -t, --threads=NUM  number of threads, default is the number of online\n"
+                  "                     processors\n",
                   stdout);
             return 0;
         }
 
-    la_read_matrices_d(stdin, matrix, &rows, &cols, LDA);
-    /* Concatenate with inverse: */
-    for (i=0; i < rows; i++)
-        for (j=0; j < cols; j++)
-            matrix[LDA * i + j + cols] = i==j;
-    puts("M and I:");
-    for (i=0; i < rows; i++, putchar('\n'))
-        for (j=0; j < cols<<1; j++)
-            printf("%.*f ", la_arg_precision, matrix[LDA * i + j]);
-    for (k=0; k < rows; k++) {
-        /* Divide the row akj by akk. */
-        for (i=k+1; i < cols<<1; i++)
-            matrix[LDA * k + i] /= matrix[LDA * k + k];
-        /* Ensures akk equals to one. */
-        matrix[LDA * k + k] = 1.f;
-        /* Subtract the next rows a(i=k+1)j by aik times akj. */
-        for (i=k+1; i < rows; i++) {
-            for (j=k+1; j < cols<<1; j++)
-                matrix[LDA * i + j] -= matrix[LDA * i + k] * matrix[LDA * k + j];
-            /* Ensures that aik equals to zero. */
-            matrix[LDA * i + k] = 0;
-        }
-        printf("Step %0d:\n", k+1);
-        la_show_matrix_d(stdout, matrix, rows, cols, LDA);
+    if (arg_batch)
+        return batch();
+    la_allocate_matrix_d(&m, 0, 0);
+    la_read_matrix_d(stdin, &m);
+    if (m.rows != m.cols) {
+        fputs("inverse: the matrix is not square.\n", stderr);
+        return 1;
     }
-    /* From the bottom up, subtract row akj times aik. */
-    for (k=rows-1; k > 0; k--)    
-        for (i=k-1; i >= 0; i--) {
-            for (j=k+1; j < cols<<1; j++)
-                matrix[LDA * i + j] -= matrix[LDA * k + j] * matrix[LDA * i + k];
-            /* Guarantees aik equals to zero. */
-            matrix[LDA * i + k] = 0;
+    ret = 0;
+    if (arg_steps)
+        gauss_jordan_steps(&m);
+    else {
+        ipiv = malloc(sizeof(int) * (m.rows? m.rows : 1));
+        if (la_getrf_dag_d(m.rows, m.cols, m.base, m.lda, ipiv, 0, arg_threads) ||
+            la_getri_d(m.rows, m.base, m.lda, ipiv, arg_threads)) {
+            fputs("inverse: the matrix is singular.\n", stderr);
+            ret = 1;
+        } else {
+            if (!la_arg_binary)
+                puts("M^-1:");
+            la_show_matrix_d(stdout, m.base, m.rows, m.cols, m.lda);
         }
-    puts("M:");
-    la_show_matrix_d(stdout, matrix, rows, cols, LDA);
-    puts("M^-1:");
-    la_show_matrix_d(stdout, &matrix[cols], rows, cols, LDA);
+        free(ipiv);
+    }
+    la_free_matrix_d(&m);
+    return ret;
 }
@@ -1,9 +1,14 @@
 /*
-    invert_matrix - v1.1.0
+    invert_matrix - v2.1.0
     Inverts a matrix.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
 
     History:
+        v2.1.0  Task-graph tiled LU with threads
+        v2.0.0  In-place inversion by LU, the column reversal moves to the
+                mirror argument, no symbolic and threads arguments
+        v1.3.0  Output format argument
+        v1.2.0  Heap-allocated matrix of any size
         v1.1.0  Printing precision argument
         v1.0.1  stream argument in la_read_one_pointer_matrix_s
         v1.0.0  First version
@@ -29,22 +34,42 @@
 main(argc, argv)
 char *argv[];
 {
-    double matrix[LA_SIZE][LA_SIZE];
-    int rows, cols;
-    int i,j;
+    la_matrix_d matrix;
+    double tmp;
+    int i, j, ret, *ipiv;
 
     struct option long_opts[] = {
         {"help", no_argument, NULL, 'h'},
+        {"mirror", no_argument, NULL, 'm'},
+        {"no-symbolic", no_argument, NULL, 'n'},
+        {"output-format", required_argument, NULL, 'o'},
         {"precision", required_argument, NULL, 'p'},
+        {"threads", required_argument, NULL, 't'},
         { 0 },
     };
     int opt;
-    int arg_precision = 6;
+    int arg_mirror = 0;
+    int arg_threads = la_nprocs();
 
-    for (; (opt = getopt_long(argc, argv, "p:", long_opts, NULL)) != -1;)
+    for (; (opt = getopt_long(argc, argv, "mno:p:t:", long_opts, NULL)) != -1;)
         switch (opt) {
+        case 'm':
+            arg_mirror = 1;
+            break;
+        case 'n':
+            la_arg_symbolic = 0;
+            break;
+        case 'o':
+            if (la_parse_output_format(optarg)) {
+                fprintf(stderr, "invert_matrix: invalid output format '%s'.\n", optarg);
+                return 2;
+            }
+            break;
         case 'p':
-            arg_precision = atoi(optarg);
+            la_arg_precision = atoi(optarg);
+            break;
+        case 't':
+            arg_threads = atoi(optarg);
             break;
         case '?':
             fputs("Try 'invert_matrix --help' for more information.\n", stderr);
@@ -52,17 +77,49 @@ char *argv[];
         case 'h':
             fputs("Usage: invert_matrix [OPTION]\n"
                   "Inverts a matrix.\n\n"
-                  "The matrix is read from standard input.\n\n"
-                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n",
+                  "The matrix is read from standard input and inverted in place, by LU\n"
+                  "factorization with partial pivoting and blocked BLAS-3 updates, with no\n"
+                  "memory beyond the matrix but a few rows. A NumPy matrix is mapped rather\n"
+                  "than read.\n\n"
+                  "  -m, --mirror       only reverse the order of the columns of each row\n"
+                  "  -n, --no-symbolic  print numbers without looking for known constants\n"
+                  "  -o, --output-format=FORMAT\n"
+                  "                     write matrices as text or bin (NumPy .npy), default is text\n"
+                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n"
+                  "  -t, --threads=NUM  number of threads, default is the number of online\n"
+                  "                     processors\n",
                   stdout);
             return 0;
         }
 
-    la_read_one_pointer_matrix_d(stdin, matrix, &rows, &cols);
-    puts("Inverted:");
-    for (i=0; i < rows; i++, putchar('\n'))
-        for (j=cols-1; j >= 0; j--)
-            printf("%.*lf ", arg_precision, matrix[i][j]);
-
-    return 0;
+    la_allocate_matrix_d(&matrix, 0, 0);
+    la_read_matrix_d(stdin, &matrix);
+    ret = 0;
+    if (arg_mirror)
+        for (i=0; i < matrix.rows; i++)
+            for (j=0; j < matrix.cols/2; j++) {
+                tmp = LA_AT(&matrix, i, j);
+                LA_AT(&matrix, i, j) = LA_AT(&matrix, i, matrix.cols-1-j);
+                LA_AT(&matrix, i, matrix.cols-1-j) = tmp;
+            }
+    else if (matrix.rows != matrix.cols) {
+        fputs("invert_matrix: the matrix is not square.\n", stderr);
+        ret = 1;
+    } else {
+        ipiv = malloc(sizeof(int) * (matrix.rows? matrix.rows : 1));
+        if (la_getrf_dag_d(matrix.rows, matrix.cols, matrix.base, matrix.lda,
+                           ipiv, 0, arg_threads) ||
+            la_getri_d(matrix.rows, matrix.base, matrix.lda, ipiv, arg_threads)) {
+            fputs("invert_matrix: the matrix is singular.\n", stderr);
+            ret = 1;
+        }
+        free(ipiv);
+    }
+    if (!ret) {
+        if (!la_arg_binary)
+            puts("Inverted:");
+        la_show_matrix_d(stdout, matrix.base, matrix.rows, matrix.cols, matrix.lda);
+    }
+    la_free_matrix_d(&matrix);
+    return ret;
 }
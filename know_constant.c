@@ -1,10 +1,11 @@
 /*
-    know_constant - v1.0.1
+    know_constant - v1.1.0
     This program generates the set of mathematical constants of
     KNOW_CONSTANT_FILENAME.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
     
     History:
+        v1.1.0  Header padded to 16 bytes, so the constants can be mapped
         v1.0.1  Forgot to add the constants
         v1.0.0  First version
 
@@ -154,7 +155,7 @@ void serializer_to(char filename[])
                 __func__, filename);
         exit(EXIT_FAILURE);
     }
-    fprintf(fp, "%lx\n", know.nmemb);
+    fprintf(fp, "%-15lx\n", know.nmemb);
     fwrite(know.base, sizeof(know_constant_c), know.nmemb, fp);
     fclose(fp);
 }
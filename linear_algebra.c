@@ -1,9 +1,41 @@
 /*
-    linear_algebra.c - v3.0.0
+    linear_algebra.c - v3.22.0
     Definitions of utility functions to deal with matrices.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
 
     History:
+        v3.22.0 Cyclic Jacobi symmetric eigensolver la_syev_jacobi_d()
+        v3.21.0 Task-graph tiled LU and Cholesky, la_getrf_dag_d() and
+                la_potrf_dag_d(), on a work-stealing pool of threads
+        v3.20.0 Out-of-core left-looking LU la_ooc_getrf_d() on panels of a
+                memory-mapped scratch file
+        v3.19.0 la_inv_batch_d() with adjugate inverses in SIMD lanes up to
+                4 x 4, la_batch_d streams of matrices and la_peek()
+        v3.18.0 la_det_batch_d() with closed forms in SIMD lanes up to 4 x 4
+        v3.17.0 Compensated and threaded la_frobenius_d()
+        v3.16.0 Fused la_vector_sums_d() and la_read_vector_chunk_d()
+        v3.15.0 Blocked Householder LQ la_gelqf_d() and la_orglq_d()
+        v3.14.0 Float LU la_getrf_s() and la_getrs_s(), and mixed-precision
+                iterative refinement la_gesv_refine_d()
+        v3.13.0 la_potrf_d() and supernodal multifrontal sparse Cholesky with
+                nested dissection ordering
+        v3.12.0 Matrix Market input in la_csr_d, la_csr_mv_d(), la_cg_d() and
+                la_gmres_d()
+        v3.11.0 la_gemm_parallel_d(), threads in la_gemm_batch_d() and
+                la_arg_pin
+        v3.10.0 la_gemm_d() with a built-in packed and cache-blocked GEMM and
+                la_arg_blas
+        v3.9.0  la_gemm_batch_d()
+        v3.8.0  NumPy .npy binary matrices in la_read_matrix_* and
+                la_show_matrix_*
+        v3.7.0  know_constants.data memory-mapped, indexed and cached lookups
+                and la_arg_symbolic
+        v3.6.0  la_strtod() replaces strtok() and atof() in the readers
+        v3.5.0  la_getri_d(), la_parallel() and la_nprocs()
+        v3.4.0  la_read_matrix_rows_*()
+        v3.3.0  BLAS-3 trailing updates in la_getrf_d() and la_getrs_d()
+        v3.2.0  LU factorization with partial pivoting and la_log_det_d()
+        v3.1.0  la_matrix_* heap-allocated matrices and la_read_matrix_*
         v3.0.0  la_arg_precision and remove last space in la_show_matrix_*()
         v2.0.5  atof() replaces torfnum_atof()
         v2.0.4  torfnum_atof macro
@@ -23,9 +55,30 @@
     more details.
 */
 
+#define _GNU_SOURCE
+
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <assert.h>
+#include <limits.h>
+#include <float.h>
+
+#include <math.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <cblas.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include "linear_algebra.h"
 #include "know_constant.h"
@@ -33,35 +86,291 @@
 
 int la_arg_precision = 6;
 
+int la_arg_symbolic = 1;
+
+/* Slots of the cache of the last numbers looked up, a power of two. */
+#define LA_KNOW_CACHE 4096
+
+/* Width of the buckets of the index, two LA_EPS so a number and the constant
+ * equal to it are at most one bucket apart. */
+#define LA_KNOW_WIDTH (2*LA_EPS)
+
+#define LA_KNOW_EMPTY LLONG_MIN
+
+static arraytyped_array_know_constant_c la_know;
+
+/* Open addressing set of the buckets that have at least one constant. */
+static long long *la_know_buckets;
+static size_t la_know_nbuckets;
+
+static struct {
+    double x;
+    know_constant_c *c;
+    unsigned char used;
+} la_know_cache[LA_KNOW_CACHE];
+
+static size_t la_know_hash(b)
+long long b;
+{
+    return (unsigned long long)b * 0x9E3779B97F4A7C15ULL >> 20;
+}
+
+static void la_know_insert(b)
+long long b;
+{
+    size_t i;
+
+    for (i = la_know_hash(b) & (la_know_nbuckets-1); la_know_buckets[i] != b;
+         i = (i+1) & (la_know_nbuckets-1))
+        if (la_know_buckets[i] == LA_KNOW_EMPTY) {
+            la_know_buckets[i] = b;
+            return;
+        }
+}
+
+static la_know_has_bucket(b)
+long long b;
+{
+    size_t i;
+
+    for (i = la_know_hash(b) & (la_know_nbuckets-1);
+         la_know_buckets[i] != LA_KNOW_EMPTY; i = (i+1) & (la_know_nbuckets-1))
+        if (la_know_buckets[i] == b)
+            return 1;
+    return 0;
+}
+
+/* Map KNOW_CONSTANT_FILENAME read-only and index it, return 0 if it is not
+ * available. */
+static la_know_load()
+{
+    struct stat st;
+    char *map, *nl;
+    size_t i, offset;
+    int fd;
+
+    if ((fd = open(KNOW_CONSTANT_FILENAME, O_RDONLY)) < 0)
+        return 0;
+    if (fstat(fd, &st) || !st.st_size ||
+        (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    if (!(nl = memchr(map, '\n', st.st_size))) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+    offset = nl+1 - map;
+    la_know.nmemb = strtoul(map, NULL, 16);
+    if (la_know.nmemb > (st.st_size - offset) / sizeof(know_constant_c))
+        la_know.nmemb = (st.st_size - offset) / sizeof(know_constant_c);
+    la_know.capacity = la_know.nmemb;
+    if (!la_know.nmemb) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+    /* Files with a header not padded by know_constant are copied. */
+    if ((size_t)(map + offset) % _Alignof(know_constant_c)) {
+        la_know.base = malloc(sizeof(know_constant_c) * la_know.nmemb);
+        memcpy(la_know.base, map + offset, sizeof(know_constant_c) * la_know.nmemb);
+        munmap(map, st.st_size);
+    } else
+        la_know.base = (know_constant_c*)(map + offset);
+
+    for (la_know_nbuckets = 1; la_know_nbuckets < 4*la_know.nmemb;)
+        la_know_nbuckets <<= 1;
+    la_know_buckets = malloc(sizeof(long long) * la_know_nbuckets);
+    for (i=0; i < la_know_nbuckets; i++)
+        la_know_buckets[i] = LA_KNOW_EMPTY;
+    for (i=0; i < la_know.nmemb; i++)
+        la_know_insert((long long)floor(la_know.base[i].val / LA_KNOW_WIDTH));
+    return 1;
+}
+
+/* The constant equal to x >= 0, or NULL. The index only rejects the numbers
+ * far from every constant, the answer comes from the same binary search as
+ * before. */
+static know_constant_c *la_know_find(x)
+double x;
+{
+    static know_constant_c c;
+    long long b;
+    size_t slot;
+    know_constant_c *ptr;
+    unsigned long long bits;
+
+    memcpy(&bits, &x, sizeof(bits));
+    slot = (bits ^ bits >> 29) * 0x9E3779B97F4A7C15ULL >> 52 & (LA_KNOW_CACHE-1);
+    if (la_know_cache[slot].used && la_know_cache[slot].x == x)
+        return la_know_cache[slot].c;
+    ptr = NULL;
+    if (x <= la_know.base[la_know.nmemb-1].val + LA_EPS) {
+        b = floor(x / LA_KNOW_WIDTH);
+        if (la_know_has_bucket(b) || la_know_has_bucket(b-1) ||
+            la_know_has_bucket(b+1)) {
+            c.val = x;
+            ptr = arraytyped_find_know_constant_c(&la_know, &c);
+        }
+    }
+    la_know_cache[slot].x = x;
+    la_know_cache[slot].c = ptr;
+    la_know_cache[slot].used = 1;
+    return ptr;
+}
+
 static la_print_know_constant(stream, x)
 FILE *stream;
 double x;
 {
-    static unsigned char opened = 0;
-    static arraytyped_array_know_constant_c know;
-    static know_constant_c c;
-    FILE *fp;
+    static int state;
     know_constant_c *ptr;
-    
-    if (!opened) {
-        /* File not found, so number not found. */
-        if (!(fp = fopen(KNOW_CONSTANT_FILENAME, "rb")))
-            return 1;
-        if (fscanf(fp, "%lx\n", &know.nmemb) != 1)
-            return 1;
-        know.capacity = know.nmemb;
-        know.base = malloc(sizeof(know_constant_c) * know.capacity);
-        fread(know.base, sizeof(know_constant_c), know.nmemb, fp);
-        fclose(fp);
-        opened = 1;
-    }
-    c.val = x < 0? -x : x;
-    if (!(ptr = arraytyped_find_know_constant_c(&know, &c)))
+
+    /* state is 0 before loading, 1 when loaded and 2 if not available. */
+    if (!state)
+        state = la_know_load()? 1 : 2;
+    if (state == 2 || !isfinite(x))
+        return 1;
+    if (!(ptr = la_know_find(x < 0? -x : x)))
         return 1;
     fprintf(stream, "%s%s", x < 0? "-" : "", ptr->symb);
     return 0;
 }
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+int la_arg_binary = 0;
+
+la_parse_output_format(s)
+char *s;
+{
+    if (!strcmp(s, "text"))
+        return la_arg_binary = 0, 0;
+    if (!strcmp(s, "bin"))
+        return la_arg_binary = 1, 0;
+    return -1;
+}
+
+/* Type of a NumPy array of elements of size bytes in this machine. */
+static char *la_npy_descr(size)
+size_t size;
+{
+    static const int one = 1;
+
+    if (*(char*)&one)
+        return size == sizeof(float)? "<f4" : "<f8";
+    return size == sizeof(float)? ">f4" : ">f8";
+}
+
+/* Write the NumPy .npy version 1.0 array with the header and every row in a
+ * single writev() call, when the system allows that many buffers. */
+static void la_write_npy(stream, a, rows, cols, lda, size)
+FILE *stream;
+char *a;
+size_t size;
+{
+    char header[LA_ALIGN*2];
+    struct iovec *iov, *v;
+    int i, n, len, iovcnt;
+    ssize_t written;
+
+    len = snprintf(header+10, sizeof(header)-10,
+                   "{'descr': '%s', 'fortran_order': False, 'shape': (%d, %d), }",
+                   la_npy_descr(size), rows, cols);
+    /* The data starts at a multiple of LA_ALIGN. */
+    for (len += 10; (len+1) % LA_ALIGN; len++)
+        header[len] = ' ';
+    header[len++] = '\n';
+    memcpy(header, "\x93NUMPY\x01\x00", 8);
+    header[8] = (len-10) & 0xff;
+    header[9] = (len-10) >> 8;
+
+    iovcnt = 1 + (lda == cols || rows < 2? 1 : rows);
+    iov = malloc(sizeof(struct iovec) * iovcnt);
+    iov[0].iov_base = header;
+    iov[0].iov_len = len;
+    if (lda == cols || rows < 2) {
+        iov[1].iov_base = a;
+        iov[1].iov_len = (size_t)rows * cols * size;
+    } else
+        for (i=0; i < rows; i++) {
+            iov[i+1].iov_base = a + (size_t)i*lda*size;
+            iov[i+1].iov_len = cols * size;
+        }
+    fflush(stream);
+    for (v=iov; iovcnt;) {
+        n = iovcnt < IOV_MAX? iovcnt : IOV_MAX;
+        if ((written = writev(fileno(stream), v, n)) < 0) {
+            perror("la_write_npy");
+            break;
+        }
+        for (; iovcnt && written >= v->iov_len; iovcnt--, v++)
+            written -= v->iov_len;
+        if (iovcnt) {
+            v->iov_base = (char*)v->iov_base + written;
+            v->iov_len -= written;
+        }
+    }
+    free(iov);
+}
+
+/* Parse the header of a NumPy .npy array, the stream is left at its data. */
+static la_read_npy_header(stream, rows, cols, descr, fortran)
+FILE *stream;
+int *rows, *cols, *fortran;
+char descr[4];
+{
+    unsigned char pre[12];
+    char *header, *p;
+    size_t len;
+    long dims[3];
+    int ndims;
+
+    if (fread(pre, 1, 10, stream) != 10 || memcmp(pre, "\x93NUMPY", 6))
+        return -1;
+    len = pre[8] | pre[9] << 8;
+    if (pre[6] >= 2) {
+        if (fread(pre+10, 1, 2, stream) != 2)
+            return -1;
+        len |= (size_t)pre[10] << 16 | (size_t)pre[11] << 24;
+    }
+    header = malloc(len+1);
+    if (fread(header, 1, len, stream) != len) {
+        free(header);
+        return -1;
+    }
+    header[len] = '\0';
+    *rows = *cols = -1;
+    if ((p = strstr(header, "'descr'")) && (p = strchr(p+7, '\'')))
+        memcpy(descr, p+1, 3), descr[3] = '\0';
+    if ((p = strstr(header, "'fortran_order'")))
+        for (p += 15; *p == ':' || *p == ' '; p++)
+            ;
+    *fortran = p && !strncmp(p, "True", 4);
+    if ((p = strstr(header, "'shape'")) && (p = strchr(p, '('))) {
+        for (p++, ndims=0; ndims < 3; ndims++) {
+            for (; *p == ' '; p++)
+                ;
+            if (*p == ')')
+                break;
+            dims[ndims] = strtol(p, &p, 10);
+            for (; *p == ' ' || *p == ','; p++)
+                ;
+        }
+        /* A scalar is a 1 x 1 matrix and a vector is a row. */
+        if (ndims == 0)
+            *rows = *cols = 1;
+        else if (ndims == 1)
+            *rows = 1, *cols = dims[0];
+        else if (ndims == 2)
+            *rows = dims[0], *cols = dims[1];
+    }
+    free(header);
+    return *rows < 0 || *cols < 0? -1 : 0;
+}
+
 void la_show_matrix_s(stream, a, rows, cols, lda)
 FILE *stream;
 float *a;
@@ -69,10 +378,14 @@ float *a;
     int i, j;
     float aij;
 
+    if (la_arg_binary) {
+        la_write_npy(stream, a, rows, cols, lda, sizeof(float));
+        return;
+    }
     for (i=0; i < rows; i++, putc('\n', stream))
         for (j=0; j < cols; j++) {
             aij = a[i * lda + j];
-            if (la_print_know_constant(stream, aij))
+            if (!la_arg_symbolic || la_print_know_constant(stream, aij))
                 fprintf(stream, "%.*f", la_arg_precision, aij);
             if (j < cols-1)
                 putc(' ', stream);
@@ -83,10 +396,7 @@ void la_show_pointer_matrix_s(stream, a, rows, cols)
 FILE *stream;
 float a[][LA_SIZE];
 {
-    int i;
-    
-    for (i=0; i < rows; i++)
-        la_show_matrix_s(stream, a[i], 1, cols, LA_SIZE);
+    la_show_matrix_s(stream, a[0], rows, cols, LA_SIZE);
 }
 
 void la_show_matrix_d(stream, a, rows, cols, lda)
@@ -96,10 +406,14 @@ double *a;
     int i, j;
     double aij;
 
+    if (la_arg_binary) {
+        la_write_npy(stream, a, rows, cols, lda, sizeof(double));
+        return;
+    }
     for (i=0; i < rows; i++, putc('\n', stream))
         for (j=0; j < cols; j++) {
             aij = a[i * lda + j];
-            if (la_print_know_constant(stream, aij))
+            if (!la_arg_symbolic || la_print_know_constant(stream, aij))
                 fprintf(stream, "%.*lf", la_arg_precision, aij);
             if (j < cols-1)
                 putc(' ', stream);
@@ -110,10 +424,102 @@ void la_show_pointer_matrix_d(stream, a, rows, cols)
 FILE *stream;
 double a[][LA_SIZE];
 {
-    int i;
-    
-    for (i=0; i < rows; i++)
-        la_show_matrix_d(stream, a[i], 1, cols, LA_SIZE);
+    la_show_matrix_d(stream, a[0], rows, cols, LA_SIZE);
+}
+
+/* Exact powers of ten of a double. */
+static const double la_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+    1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define LA_IS_SPACE(C) ((C) == ' ' || ((C) >= '\t' && (C) <= '\r'))
+#define LA_IS_DIGIT(C) ((unsigned)((C) - '0') < 10)
+
+double la_strtod(s, end)
+const char *s;
+char **end;
+{
+    const char *p, *start, *digits;
+    unsigned long long mantissa;
+    int neg, nd, e10, eneg, e;
+
+    p = s;
+    if ((neg = *p == '-') || *p == '+')
+        p++;
+    start = p;
+    mantissa = nd = e10 = 0;
+    for (; *p == '0'; p++)
+        ;
+    for (; LA_IS_DIGIT(*p); p++, nd++)
+        mantissa = mantissa * 10 + (*p - '0');
+    if (*p == '.') {
+        if (!nd)
+            for (p++; *p == '0'; p++, e10--)
+                ;
+        else
+            p++;
+        for (; LA_IS_DIGIT(*p); p++, nd++, e10--)
+            mantissa = mantissa * 10 + (*p - '0');
+    }
+    /* No digits at all, inf or nan. */
+    if (p == start || (p == start+1 && *start == '.'))
+        return strtod(s, end);
+    if (*p == 'e' || *p == 'E') {
+        digits = p++;
+        if ((eneg = *p == '-') || *p == '+')
+            p++;
+        if (!LA_IS_DIGIT(*p))
+            p = digits;
+        else {
+            for (e=0; LA_IS_DIGIT(*p); p++)
+                if (e < 10000)
+                    e = e * 10 + (*p - '0');
+            e10 += eneg? -e : e;
+        }
+    }
+    /* Clinger's fast path: both the mantissa and the power of ten are exact
+     * doubles, so one rounding gives the correctly rounded result. */
+    if (nd <= 19 && mantissa <= 1ULL << 53 && e10 >= -22 && e10 <= 22) {
+        if (end)
+            *end = (char*)p;
+        if (e10 < 0)
+            return neg? -(mantissa / la_pow10[-e10]) : mantissa / la_pow10[-e10];
+        return neg? -(mantissa * la_pow10[e10]) : mantissa * la_pow10[e10];
+    }
+    return strtod(s, end);
+}
+
+/* Parse the next number of a line into x, return the position after it or
+ * NULL at the end of the line. Characters that are not part of a number are
+ * ignored up to the next space, like atof(). */
+static char *la_next_number(p, x)
+char *p;
+double *x;
+{
+    char *end;
+
+    for (; LA_IS_SPACE(*p); p++)
+        ;
+    if (!*p)
+        return NULL;
+    *x = la_strtod(p, &end);
+    if (end == p)
+        *x = 0;
+    for (p = end; *p && !LA_IS_SPACE(*p); p++)
+        ;
+    return p;
+}
+
+/* A line with only "e" ends a matrix. */
+static la_is_end_line(line)
+char *line;
+{
+    if (*line++ != 'e')
+        return 0;
+    for (; LA_IS_SPACE(*line); line++)
+        ;
+    return !*line;
 }
 
 void la_read_one_pointer_matrix_s(stream, a, rows, cols)
@@ -123,16 +529,19 @@ int *rows, *cols;
 {
     char *line, *p;
     size_t size;
+    double x;
 
     *rows = size = 0;
     line = NULL;
     while (getline(&line, &size, stream) != EOF) {
-        if (!strcmp(line, "e\n"))
+        if (la_is_end_line(line))
             break;
+        if (!la_next_number(line, &x))
+            continue;
         *cols = 0;
-        for (p=strtok(line, " "); p; p = strtok(NULL, " ")) {
+        for (p=line; (p = la_next_number(p, &x));) {
             assert(*cols < LA_SIZE);
-            a[*rows][(*cols)++] = atof(p);
+            a[*rows][(*cols)++] = x;
         }
         ++*rows;
     }
@@ -146,16 +555,19 @@ int *rows, *cols;
 {
     char *line, *p;
     size_t size;
+    double x;
 
     *rows = size = 0;
     line = NULL;
     while (getline(&line, &size, stream) != EOF) {
-        if (!strcmp(line, "e\n"))
+        if (la_is_end_line(line))
             break;
+        if (!la_next_number(line, &x))
+            continue;
         *cols = 0;
-        for (p=strtok(line, " "); p; p = strtok(NULL, " ")) {
+        for (p=line; (p = la_next_number(p, &x));) {
             assert(*cols < LA_SIZE);
-            a[*rows][(*cols)++] = atof(p);
+            a[*rows][(*cols)++] = x;
         }
         ++*rows;
     }
@@ -169,14 +581,17 @@ int *rows, *cols;
 {
     char *line, *p;
     size_t size;
+    double x;
     
     line = NULL;
     while (getline(&line, &size, stream) != EOF) {
-        if (!strcmp(line, "e\n"))
+        if (la_is_end_line(line))
             break;
+        if (!la_next_number(line, &x))
+            continue;
         *cols = 0;
-        for (p=strtok(line, " "); p; p = strtok(NULL, " "))
-            a[*rows * lda + (*cols)++] = atof(p);
+        for (p=line; (p = la_next_number(p, &x));)
+            a[*rows * lda + (*cols)++] = x;
         ++*rows;
     }
     free(line);
@@ -189,15 +604,3645 @@ int *rows, *cols;
 {
     char *line, *p;
     size_t size;
+    double x;
     
     line = NULL;
     while (getline(&line, &size, stream) != EOF) {
-        if (!strcmp(line, "e\n"))
+        if (la_is_end_line(line))
             break;
+        if (!la_next_number(line, &x))
+            continue;
         *cols = 0;
-        for (p=strtok(line, " "); p; p = strtok(NULL, " "))
-            a[*rows * lda + (*cols)++] = atof(p);
+        for (p=line; (p = la_next_number(p, &x));)
+            a[*rows * lda + (*cols)++] = x;
         ++*rows;
     }
     free(line);
 }
+
+/* Matrices read from NumPy arrays may be mapped instead of allocated. */
+static void la_release(base, map, map_size)
+void *base;
+char *map;
+size_t map_size;
+{
+    if (map)
+        munmap(map, map_size);
+    else
+        free(base);
+}
+
+static la_round_lda(cols, size)
+size_t size;
+{
+    int per_line;
+
+    per_line = LA_ALIGN / size;
+    if (cols < 1)
+        cols = 1;
+    return (cols + per_line-1) / per_line * per_line;
+}
+
+static void *la_aligned_alloc(nmemb, size)
+size_t nmemb, size;
+{
+    void *p;
+
+    if (!(p = aligned_alloc(LA_ALIGN, nmemb * size))) {
+        fputs("[la_aligned_alloc] Not enough memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+void la_allocate_matrix_s(m, rows, cols)
+la_matrix_s *m;
+{
+    m->rows = rows;
+    m->cols = cols;
+    m->lda = la_round_lda(cols, sizeof(float));
+    m->capacity = (size_t)(rows < 1? 1 : rows) * m->lda;
+    m->base = la_aligned_alloc(m->capacity, sizeof(float));
+    m->map = NULL;
+    m->map_size = 0;
+    memset(m->base, 0, m->capacity * sizeof(float));
+}
+
+void la_resize_matrix_s(m, rows, cols)
+la_matrix_s *m;
+{
+    int i, lda, old_rows, old_cols;
+    size_t capacity;
+    float *base;
+
+    old_rows = m->rows;
+    old_cols = m->cols;
+    lda = m->lda;
+    if (cols > lda)
+        lda = la_round_lda(cols > 2*lda? cols : 2*lda, sizeof(float));
+    capacity = m->capacity / m->lda * lda;
+    if ((size_t)rows * lda > capacity)
+        capacity = (size_t)(rows > 2*m->capacity/m->lda? rows : 2*m->capacity/m->lda) * lda;
+    if (lda != m->lda || capacity != m->capacity) {
+        base = la_aligned_alloc(capacity, sizeof(float));
+        for (i=0; i < old_rows; i++)
+            memcpy(base + (size_t)i*lda, m->base + (size_t)i*m->lda,
+                   sizeof(float) * old_cols);
+        la_release(m->base, m->map, m->map_size);
+        m->map = NULL;
+        m->base = base;
+        m->lda = lda;
+        m->capacity = capacity;
+    }
+    /* Only the new cells are zeroed: the old rows when the columns grow,
+     * and the rows past the old ones. */
+    if (cols > old_cols)
+        for (i=0; i < old_rows && i < rows; i++)
+            memset(&LA_AT(m, i, old_cols), 0, sizeof(float) * (cols-old_cols));
+    for (i=old_rows; i < rows; i++)
+        memset(&LA_AT(m, i, 0), 0, sizeof(float) * cols);
+    m->rows = rows;
+    m->cols = cols;
+}
+
+void la_free_matrix_s(m)
+la_matrix_s *m;
+{
+    la_release(m->base, m->map, m->map_size);
+    m->base = NULL;
+    m->map = NULL;
+    m->rows = m->cols = m->lda = m->capacity = 0;
+}
+
+void la_allocate_matrix_d(m, rows, cols)
+la_matrix_d *m;
+{
+    m->rows = rows;
+    m->cols = cols;
+    m->lda = la_round_lda(cols, sizeof(double));
+    m->capacity = (size_t)(rows < 1? 1 : rows) * m->lda;
+    m->base = la_aligned_alloc(m->capacity, sizeof(double));
+    m->map = NULL;
+    m->map_size = 0;
+    memset(m->base, 0, m->capacity * sizeof(double));
+}
+
+void la_resize_matrix_d(m, rows, cols)
+la_matrix_d *m;
+{
+    int i, lda, old_rows, old_cols;
+    size_t capacity;
+    double *base;
+
+    old_rows = m->rows;
+    old_cols = m->cols;
+    lda = m->lda;
+    if (cols > lda)
+        lda = la_round_lda(cols > 2*lda? cols : 2*lda, sizeof(double));
+    capacity = m->capacity / m->lda * lda;
+    if ((size_t)rows * lda > capacity)
+        capacity = (size_t)(rows > 2*m->capacity/m->lda? rows : 2*m->capacity/m->lda) * lda;
+    if (lda != m->lda || capacity != m->capacity) {
+        base = la_aligned_alloc(capacity, sizeof(double));
+        for (i=0; i < old_rows; i++)
+            memcpy(base + (size_t)i*lda, m->base + (size_t)i*m->lda,
+                   sizeof(double) * old_cols);
+        la_release(m->base, m->map, m->map_size);
+        m->map = NULL;
+        m->base = base;
+        m->lda = lda;
+        m->capacity = capacity;
+    }
+    /* Only the new cells are zeroed: the old rows when the columns grow,
+     * and the rows past the old ones. */
+    if (cols > old_cols)
+        for (i=0; i < old_rows && i < rows; i++)
+            memset(&LA_AT(m, i, old_cols), 0, sizeof(double) * (cols-old_cols));
+    for (i=old_rows; i < rows; i++)
+        memset(&LA_AT(m, i, 0), 0, sizeof(double) * cols);
+    m->rows = rows;
+    m->cols = cols;
+}
+
+void la_free_matrix_d(m)
+la_matrix_d *m;
+{
+    la_release(m->base, m->map, m->map_size);
+    m->base = NULL;
+    m->map = NULL;
+    m->rows = m->cols = m->lda = m->capacity = 0;
+}
+
+/* Read a NumPy array into m. Arrays of float in C order that are in a regular
+ * file are mapped copy-on-write instead of copied. */
+static la_read_npy_s(stream, m)
+FILE *stream;
+la_matrix_s *m;
+{
+    char descr[4] = "", *map, *data;
+    int rows, cols, fortran, i, j;
+    long pos, page;
+    size_t size, bytes;
+    struct stat st;
+
+    if (la_read_npy_header(stream, &rows, &cols, descr, &fortran)) {
+        fputs("[la_read_npy_s] Invalid NumPy array.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    if (!strcmp(descr, la_npy_descr(sizeof(float))))
+        size = sizeof(float);
+    else if (!strcmp(descr, la_npy_descr(sizeof(double))))
+        size = sizeof(double);
+    else {
+        fprintf(stderr, "[la_read_npy_s] Unsupported type %s.\n", descr);
+        exit(EXIT_FAILURE);
+    }
+    bytes = (size_t)rows * cols * size;
+    pos = ftell(stream);
+    if (size == sizeof(float) && !fortran && rows && cols && pos >= 0 &&
+        !(pos % sizeof(float)) && !fstat(fileno(stream), &st) &&
+        S_ISREG(st.st_mode) && pos + bytes <= st.st_size) {
+        page = pos / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE);
+        map = mmap(NULL, bytes + pos-page, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                   fileno(stream), page);
+        if (map != MAP_FAILED) {
+            la_release(m->base, m->map, m->map_size);
+            m->map = map;
+            m->map_size = bytes + pos-page;
+            m->base = (float*)(map + pos-page);
+            m->rows = rows;
+            m->cols = m->lda = cols;
+            m->capacity = (size_t)rows * cols;
+            fseek(stream, pos + bytes, SEEK_SET);
+            return rows;
+        }
+    }
+    data = malloc(bytes? bytes : 1);
+    if (fread(data, 1, bytes, stream) != bytes) {
+        fputs("[la_read_npy_s] Truncated NumPy array.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    m->rows = m->cols = 0;
+    la_resize_matrix_s(m, rows, cols);
+    for (i=0; i < rows; i++)
+        for (j=0; j < cols; j++)
+            if (size == sizeof(float))
+                LA_AT(m, i, j) = ((float*)data)[fortran? (size_t)j*rows + i : (size_t)i*cols + j];
+            else
+                LA_AT(m, i, j) = ((double*)data)[fortran? (size_t)j*rows + i : (size_t)i*cols + j];
+    free(data);
+    return rows;
+}
+
+void la_read_matrix_s(stream, m)
+FILE *stream;
+la_matrix_s *m;
+{
+    la_read_matrix_rows_s(stream, m, INT_MAX);
+}
+
+la_read_matrix_rows_s(stream, m, max_rows)
+FILE *stream;
+la_matrix_s *m;
+{
+    char *line, *p;
+    size_t size;
+    double x;
+    int j, c;
+
+    if ((c = getc(stream)) == 0x93) {
+        ungetc(c, stream);
+        return la_read_npy_s(stream, m);
+    }
+    if (c != EOF)
+        ungetc(c, stream);
+    m->rows = m->cols = 0;
+    size = 0;
+    line = NULL;
+    while (m->rows < max_rows && getline(&line, &size, stream) != EOF) {
+        if (la_is_end_line(line))
+            break;
+        if (!la_next_number(line, &x))
+            continue;
+        la_resize_matrix_s(m, m->rows+1, m->cols);
+        for (j=0, p=line; (p = la_next_number(p, &x)); j++) {
+            if (j == m->cols)
+                la_resize_matrix_s(m, m->rows, j+1);
+            LA_AT(m, m->rows-1, j) = x;
+        }
+    }
+    free(line);
+    return m->rows;
+}
+
+/* Read a NumPy array into m. Arrays of double in C order that are in a regular
+ * file are mapped copy-on-write instead of copied. */
+static la_read_npy_d(stream, m)
+FILE *stream;
+la_matrix_d *m;
+{
+    char descr[4] = "", *map, *data;
+    int rows, cols, fortran, i, j;
+    long pos, page;
+    size_t size, bytes;
+    struct stat st;
+
+    if (la_read_npy_header(stream, &rows, &cols, descr, &fortran)) {
+        fputs("[la_read_npy_d] Invalid NumPy array.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    if (!strcmp(descr, la_npy_descr(sizeof(double))))
+        size = sizeof(double);
+    else if (!strcmp(descr, la_npy_descr(sizeof(float))))
+        size = sizeof(float);
+    else {
+        fprintf(stderr, "[la_read_npy_d] Unsupported type %s.\n", descr);
+        exit(EXIT_FAILURE);
+    }
+    bytes = (size_t)rows * cols * size;
+    pos = ftell(stream);
+    if (size == sizeof(double) && !fortran && rows && cols && pos >= 0 &&
+        !(pos % sizeof(double)) && !fstat(fileno(stream), &st) &&
+        S_ISREG(st.st_mode) && pos + bytes <= st.st_size) {
+        page = pos / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE);
+        map = mmap(NULL, bytes + pos-page, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                   fileno(stream), page);
+        if (map != MAP_FAILED) {
+            la_release(m->base, m->map, m->map_size);
+            m->map = map;
+            m->map_size = bytes + pos-page;
+            m->base = (double*)(map + pos-page);
+            m->rows = rows;
+            m->cols = m->lda = cols;
+            m->capacity = (size_t)rows * cols;
+            fseek(stream, pos + bytes, SEEK_SET);
+            return rows;
+        }
+    }
+    data = malloc(bytes? bytes : 1);
+    if (fread(data, 1, bytes, stream) != bytes) {
+        fputs("[la_read_npy_d] Truncated NumPy array.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    m->rows = m->cols = 0;
+    la_resize_matrix_d(m, rows, cols);
+    for (i=0; i < rows; i++)
+        for (j=0; j < cols; j++)
+            if (size == sizeof(double))
+                LA_AT(m, i, j) = ((double*)data)[fortran? (size_t)j*rows + i : (size_t)i*cols + j];
+            else
+                LA_AT(m, i, j) = ((float*)data)[fortran? (size_t)j*rows + i : (size_t)i*cols + j];
+    free(data);
+    return rows;
+}
+
+void la_read_matrix_d(stream, m)
+FILE *stream;
+la_matrix_d *m;
+{
+    la_read_matrix_rows_d(stream, m, INT_MAX);
+}
+
+la_read_matrix_rows_d(stream, m, max_rows)
+FILE *stream;
+la_matrix_d *m;
+{
+    char *line, *p;
+    size_t size;
+    double x;
+    int j, c;
+
+    if ((c = getc(stream)) == 0x93) {
+        ungetc(c, stream);
+        return la_read_npy_d(stream, m);
+    }
+    if (c != EOF)
+        ungetc(c, stream);
+    m->rows = m->cols = 0;
+    size = 0;
+    line = NULL;
+    while (m->rows < max_rows && getline(&line, &size, stream) != EOF) {
+        if (la_is_end_line(line))
+            break;
+        if (!la_next_number(line, &x))
+            continue;
+        la_resize_matrix_d(m, m->rows+1, m->cols);
+        for (j=0, p=line; (p = la_next_number(p, &x)); j++) {
+            if (j == m->cols)
+                la_resize_matrix_d(m, m->rows, j+1);
+            LA_AT(m, m->rows-1, j) = x;
+        }
+    }
+    free(line);
+    return m->rows;
+}
+
+la_peek(stream)
+FILE *stream;
+{
+    int c;
+
+    while ((c = getc(stream)) != EOF && isspace(c))
+        ;
+    if (c != EOF)
+        ungetc(c, stream);
+    return c;
+}
+
+void la_laswp_d(n, a, lda, k1, k2, ipiv)
+double *a;
+int *ipiv;
+{
+    int i, j;
+    double tmp, *x, *y;
+
+    for (i=k1; i < k2; i++)
+        if (ipiv[i] != i) {
+            x = a + (size_t)i*lda;
+            y = a + (size_t)ipiv[i]*lda;
+            for (j=0; j < n; j++) {
+                tmp = x[j];
+                x[j] = y[j];
+                y[j] = tmp;
+            }
+        }
+}
+
+la_getf2_d(m, n, a, lda, ipiv)
+double *a;
+int *ipiv;
+{
+    int i, j, k, p, info, min;
+    double max, akk, aik, *ak, *ai;
+
+    info = 0;
+    min = m < n? m : n;
+    for (k=0; k < min; k++) {
+        for (max=0, p=i=k; i < m; i++)
+            if (fabs(a[(size_t)i*lda + k]) > max) {
+                max = fabs(a[(size_t)i*lda + k]);
+                p = i;
+            }
+        ipiv[k] = p;
+        la_laswp_d(n, a, lda, k, k+1, ipiv);
+        ak = a + (size_t)k*lda;
+        if (!(akk = ak[k])) {
+            if (!info)
+                info = k+1;
+            continue;
+        }
+        for (i=k+1; i < m; i++) {
+            ai = a + (size_t)i*lda;
+            aik = ai[k] /= akk;
+            for (j=k+1; j < n; j++)
+                ai[j] -= aik * ak[j];
+        }
+    }
+    return info;
+}
+
+/* Trailing update of la_getrf_d(): solve L11*U12 = A12 and do
+ * A22 -= L21*U12. */
+static void la_getrf_update_d(m, n, jb, a, lda)
+double *a;
+{
+    if (n <= jb)
+        return;
+    cblas_dtrsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans, CblasUnit,
+                jb, n-jb, 1.0, a, lda, a+jb, lda);
+    if (m > jb)
+        la_gemm_d(0, m-jb, n-jb, jb, -1.0, a + (size_t)jb*lda, lda, a+jb, lda,
+                  1.0, a + (size_t)jb*lda + jb, lda);
+}
+
+la_getrf_d(m, n, a, lda, ipiv)
+double *a;
+int *ipiv;
+{
+    int i, k, jb, min, info, iinfo;
+    double *akk;
+
+    min = m < n? m : n;
+    if (min <= LA_BLOCK)
+        return la_getf2_d(m, n, a, lda, ipiv);
+    info = 0;
+    for (k=0; k < min; k += LA_BLOCK) {
+        jb = min - k < LA_BLOCK? min - k : LA_BLOCK;
+        akk = a + (size_t)k*lda + k;
+        if ((iinfo = la_getf2_d(m-k, jb, akk, lda, ipiv+k)) && !info)
+            info = iinfo + k;
+        for (i=k; i < k+jb; i++)
+            ipiv[i] += k;
+        /* Apply the panel interchanges to the columns at its left and right. */
+        la_laswp_d(k, a, lda, k, k+jb, ipiv);
+        la_laswp_d(n-k-jb, a + k+jb, lda, k, k+jb, ipiv);
+        la_getrf_update_d(m-k, n-k, jb, akk, lda);
+    }
+    return info;
+}
+
+double la_log_det_d(n, a, lda, ipiv, sign)
+double *a;
+int *ipiv, *sign;
+{
+    int k;
+    double log_det, ukk;
+
+    *sign = 1;
+    for (log_det=k=0; k < n; k++) {
+        ukk = a[(size_t)k*lda + k];
+        if (!ukk) {
+            *sign = 0;
+            return -HUGE_VAL;
+        }
+        if ((ukk < 0) != (ipiv[k] != k))
+            *sign = -*sign;
+        log_det += log(fabs(ukk));
+    }
+    return log_det;
+}
+
+void la_getrs_d(n, nrhs, a, lda, ipiv, b, ldb)
+double *a, *b;
+int *ipiv;
+{
+    if (!n || !nrhs)
+        return;
+    la_laswp_d(nrhs, b, ldb, 0, n, ipiv);
+    cblas_dtrsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans, CblasUnit,
+                n, nrhs, 1.0, a, lda, b, ldb);
+    cblas_dtrsm(CblasRowMajor, CblasLeft, CblasUpper, CblasNoTrans,
+                CblasNonUnit, n, nrhs, 1.0, a, lda, b, ldb);
+}
+
+void la_laswp_s(n, a, lda, k1, k2, ipiv)
+float *a;
+int *ipiv;
+{
+    int i, j;
+    float tmp, *x, *y;
+
+    for (i=k1; i < k2; i++)
+        if (ipiv[i] != i) {
+            x = a + (size_t)i*lda;
+            y = a + (size_t)ipiv[i]*lda;
+            for (j=0; j < n; j++) {
+                tmp = x[j];
+                x[j] = y[j];
+                y[j] = tmp;
+            }
+        }
+}
+
+la_getf2_s(m, n, a, lda, ipiv)
+float *a;
+int *ipiv;
+{
+    int i, j, k, p, info, min;
+    float max, akk, aik, *ak, *ai;
+
+    info = 0;
+    min = m < n? m : n;
+    for (k=0; k < min; k++) {
+        for (max=0, p=i=k; i < m; i++)
+            if (fabsf(a[(size_t)i*lda + k]) > max) {
+                max = fabsf(a[(size_t)i*lda + k]);
+                p = i;
+            }
+        ipiv[k] = p;
+        la_laswp_s(n, a, lda, k, k+1, ipiv);
+        ak = a + (size_t)k*lda;
+        if (!(akk = ak[k])) {
+            if (!info)
+                info = k+1;
+            continue;
+        }
+        for (i=k+1; i < m; i++) {
+            ai = a + (size_t)i*lda;
+            aik = ai[k] /= akk;
+            for (j=k+1; j < n; j++)
+                ai[j] -= aik * ak[j];
+        }
+    }
+    return info;
+}
+
+la_getrf_s(m, n, a, lda, ipiv)
+float *a;
+int *ipiv;
+{
+    int i, k, jb, min, info, iinfo;
+    float *akk;
+
+    min = m < n? m : n;
+    if (min <= LA_BLOCK)
+        return la_getf2_s(m, n, a, lda, ipiv);
+    info = 0;
+    for (k=0; k < min; k += LA_BLOCK) {
+        jb = min - k < LA_BLOCK? min - k : LA_BLOCK;
+        akk = a + (size_t)k*lda + k;
+        if ((iinfo = la_getf2_s(m-k, jb, akk, lda, ipiv+k)) && !info)
+            info = iinfo + k;
+        for (i=k; i < k+jb; i++)
+            ipiv[i] += k;
+        la_laswp_s(k, a, lda, k, k+jb, ipiv);
+        la_laswp_s(n-k-jb, a + k+jb, lda, k, k+jb, ipiv);
+        if (n-k <= jb)
+            continue;
+        cblas_strsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans,
+                    CblasUnit, jb, n-k-jb, 1.0f, akk, lda, akk+jb, lda);
+        if (m-k > jb)
+            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, m-k-jb,
+                        n-k-jb, jb, -1.0f, akk + (size_t)jb*lda, lda, akk+jb,
+                        lda, 1.0f, akk + (size_t)jb*lda + jb, lda);
+    }
+    return info;
+}
+
+void la_getrs_s(n, nrhs, a, lda, ipiv, b, ldb)
+float *a, *b;
+int *ipiv;
+{
+    if (!n || !nrhs)
+        return;
+    la_laswp_s(nrhs, b, ldb, 0, n, ipiv);
+    cblas_strsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans, CblasUnit,
+                n, nrhs, 1.0f, a, lda, b, ldb);
+    cblas_strsm(CblasRowMajor, CblasLeft, CblasUpper, CblasNoTrans,
+                CblasNonUnit, n, nrhs, 1.0f, a, lda, b, ldb);
+}
+
+/* Largest backward error |r|/(|A||x| + |b|) in the infinity norm of the
+ * columns of r = b - A*x, anorm is |A|. */
+static double la_backward_error_d(n, nrhs, anorm, r, ldr, x, ldx, b, ldb)
+double anorm, *r, *x, *b;
+{
+    int i, j;
+    double berr, rn, xn, bn, e;
+
+    berr = 0;
+    for (j=0; j < nrhs; j++) {
+        rn = xn = bn = 0;
+        for (i=0; i < n; i++) {
+            if (!(fabs(r[(size_t)i*ldr + j]) <= rn))
+                rn = fabs(r[(size_t)i*ldr + j]);
+            xn = fmax(xn, fabs(x[(size_t)i*ldx + j]));
+            bn = fmax(bn, fabs(b[(size_t)i*ldb + j]));
+        }
+        /* A NaN from an overflow in float is kept. */
+        e = rn? rn / (anorm*xn + bn) : 0;
+        if (!(e <= berr))
+            berr = e;
+    }
+    return berr;
+}
+
+la_gesv_refine_d(n, nrhs, a, lda, lu, ldlu, ipiv, b, ldb, x, ldx, max_iter, berr)
+double *a, *b, *x, *berr;
+float *lu;
+int *ipiv;
+{
+    int i, j, iter, ldr;
+    double anorm, row, tol, last, *r;
+    float *rs;
+
+    *berr = 0;
+    if (!n || !nrhs)
+        return 0;
+    for (anorm=i=0; i < n; i++) {
+        for (row=j=0; j < n; j++)
+            row += fabs(a[(size_t)i*lda + j]);
+        anorm = fmax(anorm, row);
+    }
+    tol = sqrt(n) * DBL_EPSILON;
+    ldr = nrhs;
+    r = malloc(sizeof(double) * (size_t)n * nrhs);
+    rs = malloc(sizeof(float) * (size_t)n * nrhs);
+    /* x = (LU)^-1 b in float. */
+    for (i=0; i < n; i++)
+        for (j=0; j < nrhs; j++)
+            rs[(size_t)i*ldr + j] = b[(size_t)i*ldb + j];
+    la_getrs_s(n, nrhs, lu, ldlu, ipiv, rs, ldr);
+    for (i=0; i < n; i++)
+        for (j=0; j < nrhs; j++)
+            x[(size_t)i*ldx + j] = rs[(size_t)i*ldr + j];
+    last = HUGE_VAL;
+    for (iter=0;; iter++) {
+        /* r = b - A*x in double, the correction solved in float. */
+        for (i=0; i < n; i++)
+            for (j=0; j < nrhs; j++)
+                r[(size_t)i*ldr + j] = b[(size_t)i*ldb + j];
+        la_gemm_d(0, n, nrhs, n, -1.0, a, lda, x, ldx, 1.0, r, ldr);
+        *berr = la_backward_error_d(n, nrhs, anorm, r, ldr, x, ldx, b, ldb);
+        if (*berr <= tol || iter == max_iter)
+            break;
+        /* A correction that does not halve the error will not converge: the
+         * float factors are too inaccurate for this A. */
+        if (!(*berr <= 0.5*last))
+            break;
+        last = *berr;
+        for (i=0; i < n; i++)
+            for (j=0; j < nrhs; j++)
+                rs[(size_t)i*ldr + j] = r[(size_t)i*ldr + j];
+        la_getrs_s(n, nrhs, lu, ldlu, ipiv, rs, ldr);
+        for (i=0; i < n; i++)
+            for (j=0; j < nrhs; j++)
+                x[(size_t)i*ldx + j] += rs[(size_t)i*ldr + j];
+    }
+    free(r);
+    free(rs);
+    return *berr <= tol? iter : -1;
+}
+
+/* GEMM of la_gemm_d(): LA_BLAS_SYSTEM or LA_BLAS_INTERNAL. */
+int la_arg_blas = LA_BLAS_SYSTEM;
+
+la_parse_blas(s)
+char *s;
+{
+    if (!strcmp(s, "system"))
+        return la_arg_blas = LA_BLAS_SYSTEM, 0;
+    if (!strcmp(s, "internal"))
+        return la_arg_blas = LA_BLAS_INTERNAL, 0;
+    return -1;
+}
+
+/* Cache blocking of the built-in GEMM: a KC x NR panel of B stays in L1, an
+ * MC x KC block of A in L2 and a KC x NC block of B in L3. MC is a multiple
+ * of the MR of every microkernel. */
+#define LA_GEMM_MC 96
+#define LA_GEMM_KC 256
+#define LA_GEMM_NC 2048
+
+/* Largest MR x NR tile of the microkernels. */
+#define LA_GEMM_TILE (12*16)
+
+/* A microkernel does C = alpha*A*B + beta*C for an MR x NR tile of C, from
+ * kc columns of MR packed rows of A and kc rows of NR packed columns of B. C
+ * is not read when beta is zero. */
+struct la_gemm_kernel {
+    char *name;
+    int mr, nr;
+    void (*fn)();
+};
+
+static void la_gemm_kernel_generic(kc, ap, bp, c, ldc, alpha, beta)
+double *ap, *bp, *c, alpha, beta;
+{
+    double acc[4][8];
+    int p, i, j;
+
+    memset(acc, 0, sizeof(acc));
+    for (p=0; p < kc; p++, ap += 4, bp += 8)
+        for (i=0; i < 4; i++)
+            for (j=0; j < 8; j++)
+                acc[i][j] += ap[i] * bp[j];
+    for (i=0; i < 4; i++, c += ldc)
+        for (j=0; j < 8; j++)
+            c[j] = beta? alpha*acc[i][j] + beta*c[j] : alpha*acc[i][j];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2,fma")))
+static void la_gemm_kernel_avx2(kc, ap, bp, c, ldc, alpha, beta)
+double *ap, *bp, *c, alpha, beta;
+{
+    __m256d acc[6][2], b0, b1, x, va, vb;
+    int p, i;
+
+#pragma GCC unroll 6
+    for (i=0; i < 6; i++)
+        acc[i][0] = acc[i][1] = _mm256_setzero_pd();
+    for (p=0; p < kc; p++, ap += 6, bp += 8) {
+        b0 = _mm256_load_pd(bp);
+        b1 = _mm256_load_pd(bp+4);
+#pragma GCC unroll 6
+        for (i=0; i < 6; i++) {
+            x = _mm256_broadcast_sd(ap+i);
+            acc[i][0] = _mm256_fmadd_pd(x, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_pd(x, b1, acc[i][1]);
+        }
+    }
+    va = _mm256_set1_pd(alpha);
+    vb = _mm256_set1_pd(beta);
+#pragma GCC unroll 6
+    for (i=0; i < 6; i++, c += ldc)
+        if (beta) {
+            _mm256_storeu_pd(c, _mm256_fmadd_pd(va, acc[i][0],
+                                                _mm256_mul_pd(vb, _mm256_loadu_pd(c))));
+            _mm256_storeu_pd(c+4, _mm256_fmadd_pd(va, acc[i][1],
+                                                  _mm256_mul_pd(vb, _mm256_loadu_pd(c+4))));
+        } else {
+            _mm256_storeu_pd(c, _mm256_mul_pd(va, acc[i][0]));
+            _mm256_storeu_pd(c+4, _mm256_mul_pd(va, acc[i][1]));
+        }
+}
+
+__attribute__((target("avx512f")))
+static void la_gemm_kernel_avx512(kc, ap, bp, c, ldc, alpha, beta)
+double *ap, *bp, *c, alpha, beta;
+{
+    __m512d acc[12][2], b0, b1, x, va, vb;
+    int p, i;
+
+#pragma GCC unroll 12
+    for (i=0; i < 12; i++)
+        acc[i][0] = acc[i][1] = _mm512_setzero_pd();
+    for (p=0; p < kc; p++, ap += 12, bp += 16) {
+        b0 = _mm512_load_pd(bp);
+        b1 = _mm512_load_pd(bp+8);
+#pragma GCC unroll 12
+        for (i=0; i < 12; i++) {
+            x = _mm512_set1_pd(ap[i]);
+            acc[i][0] = _mm512_fmadd_pd(x, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_pd(x, b1, acc[i][1]);
+        }
+    }
+    va = _mm512_set1_pd(alpha);
+    vb = _mm512_set1_pd(beta);
+#pragma GCC unroll 12
+    for (i=0; i < 12; i++, c += ldc)
+        if (beta) {
+            _mm512_storeu_pd(c, _mm512_fmadd_pd(va, acc[i][0],
+                                                _mm512_mul_pd(vb, _mm512_loadu_pd(c))));
+            _mm512_storeu_pd(c+8, _mm512_fmadd_pd(va, acc[i][1],
+                                                  _mm512_mul_pd(vb, _mm512_loadu_pd(c+8))));
+        } else {
+            _mm512_storeu_pd(c, _mm512_mul_pd(va, acc[i][0]));
+            _mm512_storeu_pd(c+8, _mm512_mul_pd(va, acc[i][1]));
+        }
+}
+
+#endif
+
+static struct la_gemm_kernel la_gemm_kernel = {
+    "generic", 4, 8, la_gemm_kernel_generic
+};
+static pthread_once_t la_gemm_once = PTHREAD_ONCE_INIT;
+
+/* Pick the widest microkernel the processor runs. */
+static void la_gemm_select()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const struct la_gemm_kernel avx512 = {
+        "avx512", 12, 16, la_gemm_kernel_avx512
+    }, avx2 = {
+        "avx2", 6, 8, la_gemm_kernel_avx2
+    };
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        la_gemm_kernel = avx512;
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        la_gemm_kernel = avx2;
+#endif
+}
+
+char *la_gemm_kernel_name()
+{
+    pthread_once(&la_gemm_once, la_gemm_select);
+    return la_gemm_kernel.name;
+}
+
+/* Copy the mc x kc block of A at a into panels of mr rows, each stored by
+ * columns; rows past mc are zero. */
+static void la_gemm_pack_a(mc, kc, a, lda, mr, ap)
+double *a, *ap;
+{
+    int i, p, r;
+    double *ai;
+
+    for (i=0; i < mc; i += mr, ap += (size_t)kc*mr)
+        for (r=0; r < mr; r++) {
+            ai = a + (size_t)(i+r)*lda;
+            for (p=0; p < kc; p++)
+                ap[(size_t)p*mr + r] = i+r < mc? ai[p] : 0;
+        }
+}
+
+/* Copy the kc x nc block of op(B) at b into panels of nr columns, each stored
+ * by rows; columns past nc are zero. */
+static void la_gemm_pack_b(trans_b, kc, nc, b, ldb, nr, bp)
+double *b, *bp;
+{
+    int j, p, q, w;
+    double *bj;
+
+    for (j=0; j < nc; j += nr, bp += (size_t)kc*nr) {
+        w = nc-j < nr? nc-j : nr;
+        if (trans_b)
+            for (q=0; q < nr; q++) {
+                bj = b + (size_t)(j+q)*ldb;
+                for (p=0; p < kc; p++)
+                    bp[(size_t)p*nr + q] = q < w? bj[p] : 0;
+            }
+        else
+            for (p=0; p < kc; p++) {
+                bj = b + (size_t)p*ldb + j;
+                for (q=0; q < w; q++)
+                    bp[(size_t)p*nr + q] = bj[q];
+                for (; q < nr; q++)
+                    bp[(size_t)p*nr + q] = 0;
+            }
+    }
+}
+
+/* Built-in GEMM: blocks of op(B) and A are packed so that the microkernel
+ * reads both sequentially, partial tiles go through a buffer. */
+static void la_gemm_internal_d(trans_b, m, n, k, alpha, a, lda, b, ldb, beta,
+                               c, ldc)
+double alpha, *a, *b, beta, *c;
+{
+    int jc, pc, ic, jr, ir, nc, kc, mc, mr, nr, i, j;
+    double *ap, *bp, *cij, beta_p, tile[LA_GEMM_TILE];
+
+    pthread_once(&la_gemm_once, la_gemm_select);
+    mr = la_gemm_kernel.mr;
+    nr = la_gemm_kernel.nr;
+    if (!alpha || !k) {
+        for (i=0; i < m; i++)
+            for (j=0; j < n; j++)
+                c[(size_t)i*ldc + j] = beta? beta * c[(size_t)i*ldc + j] : 0;
+        return;
+    }
+    ap = la_aligned_alloc((size_t)LA_GEMM_MC * LA_GEMM_KC, sizeof(double));
+    bp = la_aligned_alloc((size_t)LA_GEMM_KC *
+                          ((n < LA_GEMM_NC? n : LA_GEMM_NC) + nr), sizeof(double));
+    for (jc=0; jc < n; jc += LA_GEMM_NC) {
+        nc = n-jc < LA_GEMM_NC? n-jc : LA_GEMM_NC;
+        for (pc=0; pc < k; pc += LA_GEMM_KC) {
+            kc = k-pc < LA_GEMM_KC? k-pc : LA_GEMM_KC;
+            la_gemm_pack_b(trans_b, kc, nc, trans_b? b + (size_t)jc*ldb + pc :
+                           b + (size_t)pc*ldb + jc, ldb, nr, bp);
+            /* Only the first block of k scales C by beta. */
+            beta_p = pc? 1.0 : beta;
+            for (ic=0; ic < m; ic += LA_GEMM_MC) {
+                mc = m-ic < LA_GEMM_MC? m-ic : LA_GEMM_MC;
+                la_gemm_pack_a(mc, kc, a + (size_t)ic*lda + pc, lda, mr, ap);
+                for (jr=0; jr < nc; jr += nr)
+                    for (ir=0; ir < mc; ir += mr) {
+                        cij = c + (size_t)(ic+ir)*ldc + jc+jr;
+                        if (mc-ir >= mr && nc-jr >= nr) {
+                            la_gemm_kernel.fn(kc, ap + (size_t)ir*kc,
+                                              bp + (size_t)jr*kc, cij, ldc,
+                                              alpha, beta_p);
+                            continue;
+                        }
+                        la_gemm_kernel.fn(kc, ap + (size_t)ir*kc,
+                                          bp + (size_t)jr*kc, tile, nr,
+                                          alpha, 0.0);
+                        for (i=0; i < mr && i < mc-ir; i++)
+                            for (j=0; j < nr && j < nc-jr; j++)
+                                cij[(size_t)i*ldc + j] = beta_p?
+                                    tile[i*nr + j] + beta_p * cij[(size_t)i*ldc + j] :
+                                    tile[i*nr + j];
+                    }
+            }
+        }
+    }
+    free(ap);
+    free(bp);
+}
+
+void la_gemm_d(trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc)
+double alpha, *a, *b, beta, *c;
+{
+    if (m <= 0 || n <= 0)
+        return;
+    if (la_arg_blas == LA_BLAS_INTERNAL)
+        la_gemm_internal_d(trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c,
+                           ldc);
+    else
+        cblas_dgemm(CblasRowMajor, CblasNoTrans,
+                    trans_b? CblasTrans : CblasNoTrans, m, n, k, alpha, a, lda,
+                    b, ldb, beta, c, ldc);
+}
+
+/* Below this many multiplications, the overhead of a BLAS call dominates. */
+#define LA_SMALL_GEMM 4096
+
+/* Below this many multiplications, the products of a batch are split among
+ * the threads, above it each product is split in panels. */
+#define LA_PARALLEL_GEMM (1 << 20)
+
+/* Multiplications of a batch of small products worth a thread. */
+#define LA_PARALLEL_BATCH (1 << 18)
+
+struct la_gemm_args {
+    int trans_b, m, n, k, lda, ldb, ldc;
+    double alpha, *a, *b, beta, *c;
+    size_t stride_a, stride_b, stride_c;
+};
+
+/* Panels [begin, end) of LA_GEMM_MC rows of C, or columns if there are more
+ * columns than rows. */
+static void la_gemm_panels_d(p, begin, end)
+struct la_gemm_args *p;
+{
+    begin *= LA_GEMM_MC;
+    end *= LA_GEMM_MC;
+    if (p->m >= p->n) {
+        if (end > p->m)
+            end = p->m;
+        la_gemm_d(p->trans_b, end-begin, p->n, p->k, p->alpha,
+                  p->a + (size_t)begin*p->lda, p->lda, p->b, p->ldb, p->beta,
+                  p->c + (size_t)begin*p->ldc, p->ldc);
+    } else {
+        if (end > p->n)
+            end = p->n;
+        la_gemm_d(p->trans_b, p->m, end-begin, p->k, p->alpha, p->a, p->lda,
+                  p->trans_b? p->b + (size_t)begin*p->ldb : p->b + begin,
+                  p->ldb, p->beta, p->c + begin, p->ldc);
+    }
+}
+
+void la_gemm_parallel_d(trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc,
+                        nthreads)
+double alpha, *a, *b, beta, *c;
+{
+    struct la_gemm_args p;
+
+    if (nthreads <= 1 || (double)m*n*k <= LA_PARALLEL_GEMM) {
+        la_gemm_d(trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        return;
+    }
+    p.trans_b = trans_b;
+    p.m = m, p.n = n, p.k = k;
+    p.alpha = alpha, p.beta = beta;
+    p.a = a, p.lda = lda;
+    p.b = b, p.ldb = ldb;
+    p.c = c, p.ldc = ldc;
+    la_parallel(nthreads, ((m >= n? m : n) + LA_GEMM_MC-1) / LA_GEMM_MC,
+                la_gemm_panels_d, &p);
+}
+
+/* Products [begin, end) of a batch. */
+static void la_gemm_pairs_d(p, begin, end)
+struct la_gemm_args *p;
+{
+    int q, i, j, l, m, n, k;
+    double ail, *a, *b, *c, *ai, *bl, *ci;
+
+    m = p->m, n = p->n, k = p->k;
+    for (q=begin; q < end; q++) {
+        a = p->a + q*p->stride_a;
+        b = p->b + q*p->stride_b;
+        c = p->c + q*p->stride_c;
+        if ((double)m*n*k > LA_SMALL_GEMM) {
+            la_gemm_d(0, m, n, k, 1.0, a, p->lda, b, p->ldb, 0.0, c, p->ldc);
+            continue;
+        }
+        for (i=0; i < m; i++) {
+            ai = a + (size_t)i*p->lda;
+            ci = c + (size_t)i*p->ldc;
+            for (j=0; j < n; j++)
+                ci[j] = 0;
+            for (l=0; l < k; l++) {
+                ail = ai[l];
+                bl = b + (size_t)l*p->ldb;
+                for (j=0; j < n; j++)
+                    ci[j] += ail * bl[j];
+            }
+        }
+    }
+}
+
+void la_gemm_batch_d(count, m, n, k, a, lda, stride_a, b, ldb, stride_b, c,
+                     ldc, stride_c, nthreads)
+double *a, *b, *c;
+size_t stride_a, stride_b, stride_c;
+{
+    struct la_gemm_args p;
+    int q;
+    double work;
+
+    if ((double)m*n*k > LA_PARALLEL_GEMM) {
+        for (q=0; q < count; q++)
+            la_gemm_parallel_d(0, m, n, k, 1.0, a + q*stride_a, lda,
+                               b + q*stride_b, ldb, 0.0, c + q*stride_c, ldc,
+                               nthreads);
+        return;
+    }
+    p.m = m, p.n = n, p.k = k;
+    p.a = a, p.lda = lda, p.stride_a = stride_a;
+    p.b = b, p.ldb = ldb, p.stride_b = stride_b;
+    p.c = c, p.ldc = ldc, p.stride_c = stride_c;
+    /* Starting a thread costs more than a few small products. */
+    work = (double)count*m*n*k;
+    if (nthreads > work / LA_PARALLEL_BATCH)
+        nthreads = work / LA_PARALLEL_BATCH;
+    la_parallel(nthreads, count, la_gemm_pairs_d, &p);
+}
+
+struct la_parallel_slice {
+    void (*fn)();
+    void *arg;
+    int begin, end;
+    pthread_t thread;
+    int started;
+};
+
+static void *la_parallel_thread(p)
+void *p;
+{
+    struct la_parallel_slice *s = p;
+
+    s->fn(s->arg, s->begin, s->end);
+    return NULL;
+}
+
+int la_arg_pin = 0;
+
+/* The t-th processor, modulo their number, of the set allowed. */
+static void la_nth_cpu(allowed, t, cpu)
+cpu_set_t *allowed, *cpu;
+{
+    int i;
+
+    t %= CPU_COUNT(allowed);
+    for (i=0; !CPU_ISSET(i, allowed) || t--; i++)
+        ;
+    CPU_ZERO(cpu);
+    CPU_SET(i, cpu);
+}
+
+void la_parallel(nthreads, n, fn, arg)
+void (*fn)();
+void *arg;
+{
+    struct la_parallel_slice *slices;
+    pthread_attr_t attr;
+    cpu_set_t allowed, cpu;
+    int t, pin;
+
+    if (nthreads > n)
+        nthreads = n;
+    if (nthreads <= 1) {
+        fn(arg, 0, n);
+        return;
+    }
+    slices = malloc(sizeof(struct la_parallel_slice) * nthreads);
+    pthread_attr_init(&attr);
+    /* Slice t runs on the t-th processor the process may use, the calling
+     * thread gets its own affinity back at the end. */
+    pin = la_arg_pin && !pthread_getaffinity_np(pthread_self(), sizeof(allowed),
+                                                &allowed);
+    if (pin) {
+        la_nth_cpu(&allowed, 0, &cpu);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu), &cpu);
+    }
+    for (t=0; t < nthreads; t++) {
+        if (pin && t) {
+            la_nth_cpu(&allowed, t, &cpu);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu), &cpu);
+        }
+        slices[t].fn = fn;
+        slices[t].arg = arg;
+        slices[t].begin = (long)n * t / nthreads;
+        slices[t].end = (long)n * (t+1) / nthreads;
+        /* The first slice runs in the calling thread. */
+        slices[t].started = t &&
+            !pthread_create(&slices[t].thread, &attr, la_parallel_thread, &slices[t]);
+    }
+    for (t=0; t < nthreads; t++)
+        if (!slices[t].started)
+            la_parallel_thread(&slices[t]);
+    for (t=0; t < nthreads; t++)
+        if (slices[t].started)
+            pthread_join(slices[t].thread, NULL);
+    if (pin)
+        pthread_setaffinity_np(pthread_self(), sizeof(allowed), &allowed);
+    pthread_attr_destroy(&attr);
+    free(slices);
+}
+
+la_nprocs()
+{
+    long n;
+
+    return (n = sysconf(_SC_NPROCESSORS_ONLN)) > 0? n : 1;
+}
+
+/* Invert the upper triangular matrix of order n in place. */
+static void la_trti2_d(n, a, lda)
+double *a;
+{
+    int j;
+    double ajj;
+
+    for (j=0; j < n; j++) {
+        a[(size_t)j*lda + j] = 1 / a[(size_t)j*lda + j];
+        ajj = -a[(size_t)j*lda + j];
+        cblas_dtrmv(CblasRowMajor, CblasUpper, CblasNoTrans, CblasNonUnit, j,
+                    a, lda, a + j, lda);
+        cblas_dscal(j, ajj, a + j, lda);
+    }
+}
+
+static void la_trtri_d(n, a, lda)
+double *a;
+{
+    int j, jb;
+    double *ajj;
+
+    for (j=0; j < n; j += LA_BLOCK) {
+        jb = n - j < LA_BLOCK? n - j : LA_BLOCK;
+        ajj = a + (size_t)j*lda + j;
+        if (j) {
+            cblas_dtrmm(CblasRowMajor, CblasLeft, CblasUpper, CblasNoTrans,
+                        CblasNonUnit, j, jb, 1.0, a, lda, a + j, lda);
+            cblas_dtrsm(CblasRowMajor, CblasRight, CblasUpper, CblasNoTrans,
+                        CblasNonUnit, j, jb, -1.0, ajj, lda, a + j, lda);
+        }
+        la_trti2_d(jb, ajj, lda);
+    }
+}
+
+struct la_getri_panel {
+    int n, j, jb, lda;
+    double *a, *work;
+    int *ipiv;
+};
+
+/* Rows begin to end of the block column j of la_getri_d(). */
+static void la_getri_rows_d(p, begin, end)
+struct la_getri_panel *p;
+{
+    double *ai;
+    int n, j, jb;
+
+    n = p->n;
+    j = p->j;
+    jb = p->jb;
+    ai = p->a + (size_t)begin*p->lda;
+    if (j+jb < n)
+        la_gemm_d(0, end-begin, jb, n-j-jb, -1.0, ai + j+jb, p->lda,
+                  p->work + (size_t)(j+jb)*LA_BLOCK, LA_BLOCK, 1.0, ai + j, p->lda);
+    cblas_dtrsm(CblasRowMajor, CblasRight, CblasLower, CblasNoTrans, CblasUnit,
+                end-begin, jb, 1.0, p->work + (size_t)j*LA_BLOCK, LA_BLOCK,
+                ai + j, p->lda);
+}
+
+/* Undo the row interchanges of the LU factorization as column interchanges,
+ * one row at a time. */
+static void la_getri_swap_d(p, begin, end)
+struct la_getri_panel *p;
+{
+    int i, j;
+    double tmp, *ai;
+
+    for (i=begin; i < end; i++) {
+        ai = p->a + (size_t)i*p->lda;
+        for (j=p->n-2; j >= 0; j--)
+            if (p->ipiv[j] != j) {
+                tmp = ai[j];
+                ai[j] = ai[p->ipiv[j]];
+                ai[p->ipiv[j]] = tmp;
+            }
+    }
+}
+
+la_getri_d(n, a, lda, ipiv, nthreads)
+double *a;
+int *ipiv;
+{
+    struct la_getri_panel p;
+    int i, j, jj;
+
+    if (n <= 0)
+        return 0;
+    for (j=0; j < n; j++)
+        if (!a[(size_t)j*lda + j])
+            return j+1;
+    la_trtri_d(n, a, lda);
+    p.n = n;
+    p.a = a;
+    p.lda = lda;
+    p.ipiv = ipiv;
+    p.work = malloc(sizeof(double) * (size_t)n * LA_BLOCK);
+    /* Solve inv(A)*L = inv(U) from the last block column to the first. */
+    for (j = (n-1) / LA_BLOCK * LA_BLOCK; j >= 0; j -= LA_BLOCK) {
+        p.j = j;
+        p.jb = n - j < LA_BLOCK? n - j : LA_BLOCK;
+        for (i=j; i < n; i++)
+            for (jj=j; jj < j+p.jb; jj++)
+                if (i > jj) {
+                    p.work[(size_t)i*LA_BLOCK + jj-j] = a[(size_t)i*lda + jj];
+                    a[(size_t)i*lda + jj] = 0;
+                } else
+                    p.work[(size_t)i*LA_BLOCK + jj-j] = i == jj;
+        la_parallel(nthreads, n, la_getri_rows_d, &p);
+    }
+    la_parallel(nthreads, n, la_getri_swap_d, &p);
+    free(p.work);
+    return 0;
+}
+
+void la_free_csr_d(m)
+la_csr_d *m;
+{
+    free(m->row_ptr);
+    free(m->col);
+    free(m->val);
+    m->row_ptr = NULL;
+    m->col = NULL;
+    m->val = NULL;
+    m->rows = m->cols = 0;
+    m->nnz = 0;
+}
+
+static void *la_malloc(nmemb, size)
+size_t nmemb, size;
+{
+    void *p;
+
+    if (!(p = malloc(nmemb? nmemb * size : 1))) {
+        fputs("[la_malloc] Not enough memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+la_read_matrix_market_d(stream, m)
+FILE *stream;
+la_csr_d *m;
+{
+    char *line, *p, field[16], symmetry[24];
+    size_t size, nnz, ne, e, k, begin, end, *cp, *rp;
+    int rows, cols, i, j, pattern, mirror, *ri, *ci, *col;
+    double x, v, sign, *vv, *val;
+
+    line = NULL;
+    size = 0;
+    if (getline(&line, &size, stream) == EOF ||
+        sscanf(line, "%%%%MatrixMarket matrix coordinate %15s %23s", field,
+               symmetry) != 2 ||
+        (strcasecmp(field, "real") && strcasecmp(field, "integer") &&
+         strcasecmp(field, "pattern")) ||
+        (strcasecmp(symmetry, "general") && strcasecmp(symmetry, "symmetric") &&
+         strcasecmp(symmetry, "skew-symmetric"))) {
+        free(line);
+        return -1;
+    }
+    pattern = !strcasecmp(field, "pattern");
+    mirror = strcasecmp(symmetry, "general") != 0;
+    sign = strcasecmp(symmetry, "skew-symmetric")? 1 : -1;
+    do
+        if (getline(&line, &size, stream) == EOF) {
+            free(line);
+            return -1;
+        }
+    while (*line == '%' || !la_next_number(line, &x));
+    if (sscanf(line, "%d %d %zu", &rows, &cols, &nnz) != 3 || rows < 0 ||
+        cols < 0 || (mirror && rows != cols)) {
+        free(line);
+        return -1;
+    }
+    /* Coordinates, with room for the mirrored entries. */
+    ri = la_malloc(nnz * (mirror+1), sizeof(int));
+    ci = la_malloc(nnz * (mirror+1), sizeof(int));
+    vv = la_malloc(nnz * (mirror+1), sizeof(double));
+    for (ne=e=0; e < nnz;) {
+        if (getline(&line, &size, stream) == EOF)
+            break;
+        if (*line == '%' || !(p = la_next_number(line, &x)))
+            continue;
+        i = x;
+        if (!(p = la_next_number(p, &x)))
+            break;
+        j = x;
+        v = 1;
+        if (!pattern && !la_next_number(p, &v))
+            break;
+        if (i < 1 || i > rows || j < 1 || j > cols)
+            break;
+        ri[ne] = i-1, ci[ne] = j-1, vv[ne++] = v;
+        if (mirror && i != j)
+            ri[ne] = j-1, ci[ne] = i-1, vv[ne++] = sign*v;
+        e++;
+    }
+    free(line);
+    if (e < nnz) {
+        free(ri), free(ci), free(vv);
+        return -1;
+    }
+    /* Counting sort by column and then by row, so that the columns of each
+     * row come out in order. */
+    cp = calloc((size_t)cols+1, sizeof(size_t));
+    for (e=0; e < ne; e++)
+        cp[ci[e]+1]++;
+    for (j=0; j < cols; j++)
+        cp[j+1] += cp[j];
+    col = la_malloc(ne, sizeof(int));
+    val = la_malloc(ne, sizeof(double));
+    for (e=0; e < ne; e++) {
+        k = cp[ci[e]]++;
+        col[k] = ri[e];
+        val[k] = vv[e];
+    }
+    free(ci);
+    ci = col;
+    free(vv);
+    vv = val;
+    rp = calloc((size_t)rows+1, sizeof(size_t));
+    for (e=0; e < ne; e++)
+        rp[ci[e]+1]++;
+    for (i=0; i < rows; i++)
+        rp[i+1] += rp[i];
+    col = la_malloc(ne, sizeof(int));
+    val = la_malloc(ne, sizeof(double));
+    for (begin=j=0; j < cols; begin = cp[j++])
+        for (e=begin; e < cp[j]; e++) {
+            k = rp[ci[e]]++;
+            col[k] = j;
+            val[k] = vv[e];
+        }
+    free(cp), free(ri), free(ci), free(vv);
+    /* rp[i] is now the end of row i; shift it and sum duplicates. */
+    memmove(rp+1, rp, sizeof(size_t) * rows);
+    rp[0] = 0;
+    for (k=e=i=0; i < rows; i++) {
+        begin = k;
+        end = rp[i+1];
+        for (; e < end; e++)
+            if (k > begin && col[k-1] == col[e])
+                val[k-1] += val[e];
+            else {
+                col[k] = col[e];
+                val[k++] = val[e];
+            }
+        rp[i] = begin;
+    }
+    rp[rows] = k;
+    m->rows = rows;
+    m->cols = cols;
+    m->nnz = k;
+    m->row_ptr = rp;
+    m->col = col;
+    m->val = val;
+    return 0;
+}
+
+/* Below this many non-zeros, threads cost more than the product. */
+#define LA_PARALLEL_SPMV (1 << 16)
+
+struct la_csr_mv_args {
+    la_csr_d *a;
+    double *x, *y;
+};
+
+static void la_csr_mv_rows_d(p, begin, end)
+struct la_csr_mv_args *p;
+{
+    size_t k, *rp;
+    int i, *col;
+    double s, *val, *x;
+
+    rp = p->a->row_ptr;
+    col = p->a->col;
+    val = p->a->val;
+    x = p->x;
+    for (i=begin; i < end; i++) {
+        for (s=0, k=rp[i]; k < rp[i+1]; k++)
+            s += val[k] * x[col[k]];
+        p->y[i] = s;
+    }
+}
+
+void la_csr_mv_d(a, x, y, nthreads)
+la_csr_d *a;
+double *x, *y;
+{
+    struct la_csr_mv_args p;
+
+    p.a = a;
+    p.x = x;
+    p.y = y;
+    la_parallel(a->nnz < LA_PARALLEL_SPMV? 1 : nthreads, a->rows,
+                la_csr_mv_rows_d, &p);
+}
+
+/* Inverse of the diagonal of a, or 1 where it is zero: the Jacobi
+ * preconditioner of the Krylov solvers. */
+static double *la_csr_inv_diag_d(a)
+la_csr_d *a;
+{
+    double *d;
+    size_t k;
+    int i;
+
+    d = la_malloc(a->rows, sizeof(double));
+    for (i=0; i < a->rows; i++) {
+        d[i] = 1;
+        for (k=a->row_ptr[i]; k < a->row_ptr[i+1]; k++)
+            if (a->col[k] == i && a->val[k])
+                d[i] = 1 / a->val[k];
+    }
+    return d;
+}
+
+/* ||b - A*x|| with r as work space. */
+static double la_csr_residual_d(a, b, x, r, nthreads)
+la_csr_d *a;
+double *b, *x, *r;
+{
+    int i;
+
+    la_csr_mv_d(a, x, r, nthreads);
+    for (i=0; i < a->rows; i++)
+        r[i] = b[i] - r[i];
+    return cblas_dnrm2(a->rows, r, 1);
+}
+
+la_cg_d(a, b, x, tol, max_iter, nthreads, residual)
+la_csr_d *a;
+double *b, *x, tol, *residual;
+{
+    int n, i, it;
+    double *r, *z, *p, *q, *d, nb, rz, rz_old, rr, pq, alpha;
+
+    n = a->rows;
+    if (!(nb = cblas_dnrm2(n, b, 1))) {
+        memset(x, 0, sizeof(double) * n);
+        *residual = 0;
+        return 0;
+    }
+    r = la_malloc(n, sizeof(double));
+    z = la_malloc(n, sizeof(double));
+    p = la_malloc(n, sizeof(double));
+    q = la_malloc(n, sizeof(double));
+    d = la_csr_inv_diag_d(a);
+    la_csr_residual_d(a, b, x, r, nthreads);
+    for (rz=rr=i=0; i < n; i++) {
+        p[i] = z[i] = d[i] * r[i];
+        rz += r[i] * z[i];
+        rr += r[i] * r[i];
+    }
+    for (it=0; it < max_iter && sqrt(rr) > tol * nb; it++) {
+        la_csr_mv_d(a, p, q, nthreads);
+        /* Not positive definite. */
+        if ((pq = cblas_ddot(n, p, 1, q, 1)) <= 0)
+            break;
+        alpha = rz / pq;
+        cblas_daxpy(n, alpha, p, 1, x, 1);
+        /* r -= alpha*q, z = D*r and the new products in one pass. */
+        rz_old = rz;
+        for (rz=rr=i=0; i < n; i++) {
+            r[i] -= alpha * q[i];
+            z[i] = d[i] * r[i];
+            rz += r[i] * z[i];
+            rr += r[i] * r[i];
+        }
+        for (i=0; i < n; i++)
+            p[i] = z[i] + rz / rz_old * p[i];
+    }
+    /* The recurrence drifts from the true residual. */
+    *residual = la_csr_residual_d(a, b, x, r, nthreads) / nb;
+    free(r), free(z), free(p), free(q), free(d);
+    return it;
+}
+
+la_gmres_d(a, b, x, restart, tol, max_iter, nthreads, residual)
+la_csr_d *a;
+double *b, *x, tol, *residual;
+{
+    int n, m, i, j, l, it;
+    double *v, *h, *cs, *sn, *g, *w, *d, nb, beta, den, tmp;
+
+    n = a->rows;
+    if (!(nb = cblas_dnrm2(n, b, 1))) {
+        memset(x, 0, sizeof(double) * n);
+        *residual = 0;
+        return 0;
+    }
+    m = restart < 1? 1 : restart > n? n : restart;
+    /* Krylov basis v, Hessenberg matrix h of (m+1) x m and the Givens
+     * rotations that make it upper triangular. */
+    v = la_malloc((size_t)(m+1) * n, sizeof(double));
+    h = la_malloc((size_t)(m+1) * m, sizeof(double));
+    cs = la_malloc(m, sizeof(double));
+    sn = la_malloc(m, sizeof(double));
+    g = la_malloc(m+1, sizeof(double));
+    w = la_malloc(n, sizeof(double));
+    d = la_csr_inv_diag_d(a);
+    for (it=0;;) {
+        beta = la_csr_residual_d(a, b, x, v, nthreads);
+        if (beta <= tol * nb || it >= max_iter || !beta)
+            break;
+        cblas_dscal(n, 1/beta, v, 1);
+        memset(g, 0, sizeof(double) * (m+1));
+        g[0] = beta;
+        for (j=0; j < m && it < max_iter; ) {
+            /* Right preconditioned: w = A*D*v_j. */
+            for (i=0; i < n; i++)
+                w[i] = d[i] * v[(size_t)j*n + i];
+            la_csr_mv_d(a, w, v + (size_t)(j+1)*n, nthreads);
+            for (i=0; i <= j; i++) {
+                h[i*m + j] = cblas_ddot(n, v + (size_t)(j+1)*n, 1,
+                                        v + (size_t)i*n, 1);
+                cblas_daxpy(n, -h[i*m + j], v + (size_t)i*n, 1,
+                            v + (size_t)(j+1)*n, 1);
+            }
+            h[(j+1)*m + j] = cblas_dnrm2(n, v + (size_t)(j+1)*n, 1);
+            if (h[(j+1)*m + j])
+                cblas_dscal(n, 1/h[(j+1)*m + j], v + (size_t)(j+1)*n, 1);
+            for (i=0; i < j; i++) {
+                tmp = cs[i]*h[i*m + j] + sn[i]*h[(i+1)*m + j];
+                h[(i+1)*m + j] = -sn[i]*h[i*m + j] + cs[i]*h[(i+1)*m + j];
+                h[i*m + j] = tmp;
+            }
+            if (!(den = hypot(h[j*m + j], h[(j+1)*m + j])))
+                break;
+            cs[j] = h[j*m + j] / den;
+            sn[j] = h[(j+1)*m + j] / den;
+            h[j*m + j] = den;
+            g[j+1] = -sn[j] * g[j];
+            g[j] *= cs[j];
+            j++, it++;
+            if (fabs(g[j]) <= tol * nb)
+                break;
+        }
+        if (!j)
+            break;
+        /* Solve the triangular system for the coefficients, in g, and add
+         * D times their combination of the basis to x. */
+        for (i=j-1; i >= 0; i--) {
+            for (l=i+1; l < j; l++)
+                g[i] -= h[i*m + l] * g[l];
+            g[i] /= h[i*m + i];
+        }
+        memset(w, 0, sizeof(double) * n);
+        for (i=0; i < j; i++)
+            cblas_daxpy(n, g[i], v + (size_t)i*n, 1, w, 1);
+        for (i=0; i < n; i++)
+            x[i] += d[i] * w[i];
+    }
+    *residual = beta / nb;
+    free(v), free(h), free(cs), free(sn), free(g), free(w), free(d);
+    return it;
+}
+
+/* Cholesky factorization of the n x n leading block of the m x m lower
+ * triangle of a, with the Schur complement of the remaining m-n rows left
+ * in their place. Return 0, or j if the j-th pivot is not positive. */
+static la_potrf_partial_d(m, n, a, lda)
+double *a;
+{
+    int j, jb, c, r, p;
+    double d, *ajj;
+
+    for (j=0; j < n; j += LA_BLOCK) {
+        jb = n-j < LA_BLOCK? n-j : LA_BLOCK;
+        ajj = a + (size_t)j*lda + j;
+        for (c=0; c < jb; c++) {
+            d = ajj[(size_t)c*lda + c];
+            for (p=0; p < c; p++)
+                d -= ajj[(size_t)c*lda + p] * ajj[(size_t)c*lda + p];
+            if (!(d > 0))
+                return j+c+1;
+            ajj[(size_t)c*lda + c] = d = sqrt(d);
+            for (r=c+1; r < jb; r++) {
+                for (p=0; p < c; p++)
+                    ajj[(size_t)r*lda + c] -= ajj[(size_t)r*lda + p] *
+                                              ajj[(size_t)c*lda + p];
+                ajj[(size_t)r*lda + c] /= d;
+            }
+        }
+        if (m-j-jb <= 0)
+            continue;
+        cblas_dtrsm(CblasRowMajor, CblasRight, CblasLower, CblasTrans,
+                    CblasNonUnit, m-j-jb, jb, 1.0, ajj, lda,
+                    ajj + (size_t)jb*lda, lda);
+        cblas_dsyrk(CblasRowMajor, CblasLower, CblasNoTrans, m-j-jb, jb, -1.0,
+                    ajj + (size_t)jb*lda, lda, 1.0,
+                    ajj + (size_t)jb*lda + jb, lda);
+    }
+    return 0;
+}
+
+la_potrf_d(n, a, lda)
+double *a;
+{
+    return la_potrf_partial_d(n, n, a, lda);
+}
+
+/* Tasks of the task-graph factorizations, run by a pool of threads as soon
+ * as the tasks they depend on are done. Each thread takes the tasks it makes
+ * ready from the end of its own deque, the last first, and when it has none
+ * steals the oldest from the other threads; with none to steal, it sleeps
+ * until a task is pushed or the last one is done. */
+struct la_task {
+    int type, k, i, j;
+};
+
+struct la_deque {
+    pthread_mutex_t lock;
+    struct la_task *t;
+    int head, tail, cap;
+};
+
+struct la_pool {
+    struct la_deque *q;
+    int nthreads;
+    /* Tasks not done and tasks in the deques; idle threads wait for wake. */
+    long remaining, queued;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    void (*run)();
+    void *arg;
+};
+
+static void la_pool_init(pool, nthreads, total, run, arg)
+struct la_pool *pool;
+long total;
+void (*run)();
+void *arg;
+{
+    int t;
+
+    pool->q = la_malloc(nthreads, sizeof(struct la_deque));
+    for (t=0; t < nthreads; t++) {
+        pthread_mutex_init(&pool->q[t].lock, NULL);
+        pool->q[t].cap = 64;
+        pool->q[t].t = la_malloc(pool->q[t].cap, sizeof(struct la_task));
+        pool->q[t].head = pool->q[t].tail = 0;
+    }
+    pool->nthreads = nthreads;
+    pool->remaining = total;
+    pool->queued = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pool->run = run;
+    pool->arg = arg;
+}
+
+static void la_pool_free(pool)
+struct la_pool *pool;
+{
+    int t;
+
+    for (t=0; t < pool->nthreads; t++) {
+        pthread_mutex_destroy(&pool->q[t].lock);
+        free(pool->q[t].t);
+    }
+    free(pool->q);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+}
+
+/* Make a task ready in the deque of thread self. */
+static void la_pool_push(pool, self, type, k, i, j)
+struct la_pool *pool;
+{
+    struct la_deque *q = pool->q + self;
+    struct la_task *t;
+    int n, c;
+
+    pthread_mutex_lock(&q->lock);
+    if ((n = q->tail - q->head) == q->cap) {
+        /* The ring is full: unroll it into one twice as large. */
+        t = la_malloc(2 * q->cap, sizeof(struct la_task));
+        for (c=0; c < n; c++)
+            t[c] = q->t[(q->head + c) % q->cap];
+        free(q->t);
+        q->t = t;
+        q->cap *= 2;
+        q->head = 0;
+        q->tail = n;
+    }
+    t = q->t + q->tail++ % q->cap;
+    t->type = type, t->k = k, t->i = i, t->j = j;
+    pthread_mutex_unlock(&q->lock);
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_ACQ_REL);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Take the newest task of thread self, or steal the oldest of another one.
+ * Return 0 if no task is ready. */
+static la_pool_pop(pool, self, task)
+struct la_pool *pool;
+struct la_task *task;
+{
+    struct la_deque *q;
+    int t, found;
+
+    for (found=t=0; !found && t < pool->nthreads; t++) {
+        q = pool->q + (self + t) % pool->nthreads;
+        pthread_mutex_lock(&q->lock);
+        if ((found = q->tail > q->head)) {
+            if (!t)
+                *task = q->t[--q->tail % q->cap];
+            else
+                *task = q->t[q->head++ % q->cap];
+        }
+        if (q->head == q->tail)
+            q->head = q->tail = 0;
+        pthread_mutex_unlock(&q->lock);
+    }
+    if (found)
+        __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_ACQ_REL);
+    return found;
+}
+
+static void la_pool_worker(pool, begin, end)
+struct la_pool *pool;
+{
+    struct la_task task;
+
+    for (;;) {
+        if (la_pool_pop(pool, begin, &task)) {
+            pool->run(pool->arg, pool, begin, &task);
+            if (__atomic_sub_fetch(&pool->remaining, 1, __ATOMIC_ACQ_REL))
+                continue;
+            pthread_mutex_lock(&pool->lock);
+            pthread_cond_broadcast(&pool->wake);
+            pthread_mutex_unlock(&pool->lock);
+            return;
+        }
+        /* A push counts its task under the lock, so it is not missed. */
+        pthread_mutex_lock(&pool->lock);
+        while (!__atomic_load_n(&pool->queued, __ATOMIC_ACQUIRE) &&
+               __atomic_load_n(&pool->remaining, __ATOMIC_ACQUIRE) > 0)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+        if (__atomic_load_n(&pool->remaining, __ATOMIC_ACQUIRE) <= 0)
+            return;
+    }
+}
+
+/* Thread count of OpenBLAS, when it is the system CBLAS. */
+extern void openblas_set_num_threads(int) __attribute__((weak));
+extern int openblas_get_num_threads(void) __attribute__((weak));
+
+/* Run the tasks already pushed and the ones they make ready until total
+ * are done, by one worker per thread. The tasks are the parallelism, so the
+ * CBLAS calls in them run in one thread each. */
+static void la_pool_run(pool)
+struct la_pool *pool;
+{
+    int blas_threads;
+
+    blas_threads = 0;
+    if (pool->nthreads > 1 && openblas_get_num_threads &&
+        openblas_set_num_threads) {
+        blas_threads = openblas_get_num_threads();
+        openblas_set_num_threads(1);
+    }
+    la_parallel(pool->nthreads, pool->nthreads, la_pool_worker, pool);
+    if (blas_threads)
+        openblas_set_num_threads(blas_threads);
+}
+
+/* One less task to wait for; if it was the last, the task is ready. */
+static void la_pool_release(pool, self, count, type, k, i, j)
+struct la_pool *pool;
+int *count;
+{
+    if (!__atomic_sub_fetch(count, 1, __ATOMIC_ACQ_REL))
+        la_pool_push(pool, self, type, k, i, j);
+}
+
+#define LA_TASK_PANEL 0
+#define LA_TASK_SWAP_TRSM 1
+#define LA_TASK_GEMM 2
+
+/* Task graph of la_getrf_dag_d() on tiles of nb x nb. The panel k is the
+ * column of tiles k from the diagonal down, factored as a whole so that the
+ * pivots are the ones of la_getrf_d(). */
+struct la_getrf_dag {
+    int m, n, nb, mt, nt, kt, lda, info;
+    double *a;
+    int *ipiv;
+    /* Tasks left before the panel k and before the interchanges and
+     * triangular solve of panel k on the column of tiles j. */
+    int *panel, *swap;
+};
+
+#define LA_TILE_AT(D, I, J) ((D)->a + (size_t)(I)*(D)->nb*(D)->lda + (size_t)(J)*(D)->nb)
+#define LA_TILE_SIZE(D, T, N) ((N) - (T)*(D)->nb < (D)->nb? (N) - (T)*(D)->nb : (D)->nb)
+
+static void la_getrf_task_d(d, pool, self, t)
+struct la_getrf_dag *d;
+struct la_pool *pool;
+struct la_task *t;
+{
+    int k, i, j, r, c, jb, info;
+
+    k = t->k, i = t->i, j = t->j;
+    r = k*d->nb;
+    jb = LA_TILE_SIZE(d, k, d->m < d->n? d->m : d->n);
+    switch (t->type) {
+    case LA_TASK_PANEL:
+        /* The panels are done in order, each after the previous one. */
+        info = la_getrf_d(d->m - r, LA_TILE_SIZE(d, k, d->n), LA_TILE_AT(d, k, k),
+                          d->lda, d->ipiv + r);
+        if (info && !d->info)
+            d->info = info + r;
+        for (c=r; c < r+jb; c++)
+            d->ipiv[c] += r;
+        for (c=k+1; c < d->nt; c++)
+            la_pool_release(pool, self, d->swap + (size_t)k*d->nt + c,
+                            LA_TASK_SWAP_TRSM, k, 0, c);
+        break;
+    case LA_TASK_SWAP_TRSM:
+        c = LA_TILE_SIZE(d, j, d->n);
+        la_laswp_d(c, d->a + (size_t)j*d->nb, d->lda, r, r+jb, d->ipiv);
+        cblas_dtrsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans,
+                    CblasUnit, jb, c, 1.0, LA_TILE_AT(d, k, k), d->lda,
+                    LA_TILE_AT(d, k, j), d->lda);
+        for (i=k+1; i < d->mt; i++)
+            la_pool_push(pool, self, LA_TASK_GEMM, k, i, j);
+        break;
+    case LA_TASK_GEMM:
+        la_gemm_d(0, LA_TILE_SIZE(d, i, d->m), LA_TILE_SIZE(d, j, d->n), jb,
+                  -1.0, LA_TILE_AT(d, i, k), d->lda, LA_TILE_AT(d, k, j), d->lda,
+                  1.0, LA_TILE_AT(d, i, j), d->lda);
+        /* Pushed last, the next panel is taken first. */
+        if (j == k+1)
+            la_pool_release(pool, self, d->panel + k+1, LA_TASK_PANEL, k+1, 0, 0);
+        else
+            la_pool_release(pool, self, d->swap + (size_t)(k+1)*d->nt + j,
+                            LA_TASK_SWAP_TRSM, k+1, 0, j);
+        break;
+    }
+}
+
+/* The interchanges of the panels at the right of the columns of tiles
+ * begin to end. */
+static void la_getrf_swap_left_d(d, begin, end)
+struct la_getrf_dag *d;
+{
+    int j, min;
+
+    min = d->m < d->n? d->m : d->n;
+    for (j=begin; j < end; j++)
+        la_laswp_d(LA_TILE_SIZE(d, j, d->n), d->a + (size_t)j*d->nb, d->lda,
+                   (j+1)*d->nb, min, d->ipiv);
+}
+
+la_getrf_dag_d(m, n, a, lda, ipiv, nb, nthreads)
+double *a;
+int *ipiv;
+{
+    struct la_getrf_dag d;
+    struct la_pool pool;
+    long total;
+    int k, j;
+
+    if (nb < 1)
+        nb = LA_TILE;
+    if (nthreads <= 1 || (m < n? m : n) <= nb)
+        return la_getrf_d(m, n, a, lda, ipiv);
+    d.m = m, d.n = n, d.nb = nb, d.a = a, d.lda = lda, d.ipiv = ipiv;
+    d.mt = (m + nb-1) / nb;
+    d.nt = (n + nb-1) / nb;
+    d.kt = d.mt < d.nt? d.mt : d.nt;
+    d.info = 0;
+    d.panel = la_malloc(d.kt, sizeof(int));
+    d.swap = la_malloc((size_t)d.kt * d.nt, sizeof(int));
+    for (total=k=0; k < d.kt; k++) {
+        d.panel[k] = k? d.mt - k : 0;
+        for (j=k+1; j < d.nt; j++)
+            d.swap[(size_t)k*d.nt + j] = 1 + (k? d.mt - k : 0);
+        total += 1 + (long)(d.nt-k-1) * (d.mt - k);
+    }
+    la_pool_init(&pool, nthreads, total, la_getrf_task_d, &d);
+    la_pool_push(&pool, 0, LA_TASK_PANEL, 0, 0, 0);
+    la_pool_run(&pool);
+    la_pool_free(&pool);
+    la_parallel(nthreads, d.kt - 1, la_getrf_swap_left_d, &d);
+    free(d.panel), free(d.swap);
+    return d.info;
+}
+
+#define LA_TASK_POTRF 0
+#define LA_TASK_TRSM 1
+#define LA_TASK_UPDATE 2
+
+/* Task graph of la_potrf_dag_d() on the tiles of the lower triangle. Tiles
+ * are nb x nb from the first row, and again from row n, so that the columns
+ * factored end at a tile. */
+struct la_potrf_dag {
+    int m, n, nb, mt, kt, lda, info;
+    double *a;
+    /* Updates left before the last task of each tile, its Cholesky
+     * factorization or its triangular solve, and which triangular solves of
+     * each step are done. */
+    int *count;
+    char *solved;
+    /* Updates of a tile by different steps are one at a time. */
+    pthread_mutex_t *lock, step;
+};
+
+static la_potrf_dag_start(d, t)
+struct la_potrf_dag *d;
+{
+    return t < d->kt? t*d->nb : d->n + (t - d->kt)*d->nb;
+}
+
+static la_potrf_dag_size(d, t)
+struct la_potrf_dag *d;
+{
+    return (t+1 < d->mt? la_potrf_dag_start(d, t+1) : d->m) - la_potrf_dag_start(d, t);
+}
+
+#define LA_POTRF_TILE(D, I, J) ((D)->a + (size_t)la_potrf_dag_start(D, I)*(D)->lda + la_potrf_dag_start(D, J))
+
+static void la_potrf_task_d(d, pool, self, t)
+struct la_potrf_dag *d;
+struct la_pool *pool;
+struct la_task *t;
+{
+    int k, i, j, c, info;
+
+    k = t->k, i = t->i, j = t->j;
+    switch (t->type) {
+    case LA_TASK_POTRF:
+        if ((info = la_potrf_partial_d(la_potrf_dag_size(d, k),
+                                       la_potrf_dag_size(d, k),
+                                       LA_POTRF_TILE(d, k, k), d->lda))) {
+            info += la_potrf_dag_start(d, k);
+            pthread_mutex_lock(&d->step);
+            if (!d->info || info < d->info)
+                d->info = info;
+            pthread_mutex_unlock(&d->step);
+        }
+        for (c=k+1; c < d->mt; c++)
+            la_pool_release(pool, self, d->count + (size_t)c*d->mt + k,
+                            LA_TASK_TRSM, k, c, k);
+        break;
+    case LA_TASK_TRSM:
+        cblas_dtrsm(CblasRowMajor, CblasRight, CblasLower, CblasTrans,
+                    CblasNonUnit, la_potrf_dag_size(d, i),
+                    la_potrf_dag_size(d, k), 1.0, LA_POTRF_TILE(d, k, k),
+                    d->lda, LA_POTRF_TILE(d, i, k), d->lda);
+        /* The updates of step k need the solves of both their tiles. */
+        la_pool_push(pool, self, LA_TASK_UPDATE, k, i, i);
+        pthread_mutex_lock(&d->step);
+        d->solved[(size_t)k*d->mt + i] = 1;
+        for (c=k+1; c < d->mt; c++)
+            if (c != i && d->solved[(size_t)k*d->mt + c])
+                la_pool_push(pool, self, LA_TASK_UPDATE, k, c > i? c : i,
+                             c > i? i : c);
+        pthread_mutex_unlock(&d->step);
+        break;
+    case LA_TASK_UPDATE:
+        pthread_mutex_lock(d->lock + (size_t)i*d->mt + j);
+        if (i == j)
+            cblas_dsyrk(CblasRowMajor, CblasLower, CblasNoTrans,
+                        la_potrf_dag_size(d, i), la_potrf_dag_size(d, k), -1.0,
+                        LA_POTRF_TILE(d, i, k), d->lda, 1.0,
+                        LA_POTRF_TILE(d, i, i), d->lda);
+        else
+            cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans,
+                        la_potrf_dag_size(d, i), la_potrf_dag_size(d, j),
+                        la_potrf_dag_size(d, k), -1.0, LA_POTRF_TILE(d, i, k),
+                        d->lda, LA_POTRF_TILE(d, j, k), d->lda, 1.0,
+                        LA_POTRF_TILE(d, i, j), d->lda);
+        pthread_mutex_unlock(d->lock + (size_t)i*d->mt + j);
+        /* The Schur complement has no last task. */
+        if (j < d->kt)
+            la_pool_release(pool, self, d->count + (size_t)i*d->mt + j,
+                            i == j? LA_TASK_POTRF : LA_TASK_TRSM, j, i, j);
+        break;
+    }
+}
+
+la_potrf_dag_d(m, n, a, lda, nb, nthreads)
+double *a;
+{
+    struct la_potrf_dag d;
+    struct la_pool pool;
+    long total, r;
+    int i, j, k;
+
+    if (nb < 1)
+        nb = LA_TILE;
+    if (nthreads <= 1 || n <= nb)
+        return la_potrf_partial_d(m, n, a, lda);
+    d.m = m, d.n = n, d.nb = nb, d.a = a, d.lda = lda;
+    d.kt = (n + nb-1) / nb;
+    d.mt = d.kt + (m - n + nb-1) / nb;
+    d.info = 0;
+    d.count = la_malloc((size_t)d.mt * d.mt, sizeof(int));
+    d.solved = calloc((size_t)d.mt * d.mt, 1);
+    d.lock = la_malloc((size_t)d.mt * d.mt, sizeof(pthread_mutex_t));
+    pthread_mutex_init(&d.step, NULL);
+    for (i=0; i < d.mt; i++)
+        for (j=0; j <= i; j++) {
+            pthread_mutex_init(d.lock + (size_t)i*d.mt + j, NULL);
+            d.count[(size_t)i*d.mt + j] = j + (i > j);
+        }
+    /* A factorization and mt-k-1 solves by step, and an update of each tile
+     * of the trailing triangle. */
+    for (total=k=0; k < d.kt; k++) {
+        r = d.mt - k - 1;
+        total += 1 + r + r*(r+1)/2;
+    }
+    la_pool_init(&pool, nthreads, total, la_potrf_task_d, &d);
+    la_pool_push(&pool, 0, LA_TASK_POTRF, 0, 0, 0);
+    la_pool_run(&pool);
+    la_pool_free(&pool);
+    for (i=0; i < d.mt; i++)
+        for (j=0; j <= i; j++)
+            pthread_mutex_destroy(d.lock + (size_t)i*d.mt + j);
+    pthread_mutex_destroy(&d.step);
+    free(d.count), free(d.solved), free(d.lock);
+    return d.info;
+}
+
+/* Subsets of at most this many vertices are not dissected further. */
+#define LA_ND_LEAF 64
+
+/* Breadth-first search from v in the vertices marked with stamp; level[u] is
+ * the distance to v. Return the number of vertices reached, in queue. */
+static la_nd_bfs(a, v, mark, stamp, level, queue)
+la_csr_d *a;
+int *mark, *level, *queue;
+{
+    int head, tail, u, w;
+    size_t k;
+
+    queue[0] = v;
+    level[v] = 0;
+    mark[v] = -stamp;
+    for (head=0, tail=1; head < tail; head++) {
+        u = queue[head];
+        for (k=a->row_ptr[u]; k < a->row_ptr[u+1]; k++)
+            if (mark[w = a->col[k]] == stamp) {
+                mark[w] = -stamp;
+                level[w] = level[u] + 1;
+                queue[tail++] = w;
+            }
+    }
+    for (head=0; head < tail; head++)
+        mark[queue[head]] = stamp;
+    return tail;
+}
+
+/* Nested dissection by level structures: perm[lo, hi) holds a subset of the
+ * vertices of the graph of a, which is split by the middle level of a search
+ * from a pseudo-peripheral vertex; the two parts are ordered first and the
+ * separator last. Disconnected subsets are split by components. */
+static void la_nd_order(a, perm)
+la_csr_d *a;
+int *perm;
+{
+    int *mark, *level, *queue, *part, *stack;
+    int n, sp, lo, hi, stamp, reached, last, i, j, v, mid, n1, n2;
+    size_t k;
+
+    n = a->rows;
+    mark = calloc(n? n : 1, sizeof(int));
+    level = la_malloc(n, sizeof(int));
+    queue = la_malloc(n, sizeof(int));
+    part = la_malloc(n, sizeof(int));
+    stack = la_malloc(2 * (size_t)n + 2, sizeof(int));
+    for (i=0; i < n; i++)
+        perm[i] = i;
+    stamp = sp = 0;
+    stack[sp++] = 0;
+    stack[sp++] = n;
+    while (sp) {
+        hi = stack[--sp];
+        lo = stack[--sp];
+        if (hi - lo <= LA_ND_LEAF)
+            continue;
+        stamp++;
+        for (i=lo; i < hi; i++)
+            mark[perm[i]] = stamp;
+        /* Pseudo-peripheral vertex: restart from the farthest one while the
+         * depth grows. */
+        reached = la_nd_bfs(a, perm[lo], mark, stamp, level, queue);
+        for (j=0; j < 4 && reached == hi-lo; j++) {
+            last = level[queue[reached-1]];
+            reached = la_nd_bfs(a, queue[reached-1], mark, stamp, level, queue);
+            if (level[queue[reached-1]] <= last)
+                break;
+        }
+        last = level[queue[reached-1]];
+        if (reached < hi-lo) {
+            /* The component searched, then the rest. */
+            for (i=0; i < reached; i++)
+                part[i] = 0;
+        } else if (last < 2)
+            continue;
+        else {
+            /* The separator is the vertices of the middle level with a
+             * neighbor beyond it, the others join the first part. */
+            mid = level[queue[reached/2]];
+            mid = mid < 1? 1 : mid > last-1? last-1 : mid;
+            for (i=0; i < reached; i++) {
+                v = queue[i];
+                part[i] = level[v] < mid? 0 : level[v] > mid? 1 : 0;
+                if (level[v] == mid)
+                    for (k=a->row_ptr[v]; k < a->row_ptr[v+1]; k++)
+                        if (mark[a->col[k]] == stamp && level[a->col[k]] > mid) {
+                            part[i] = 2;
+                            break;
+                        }
+            }
+        }
+        for (i=0; i < reached; i++)
+            mark[queue[i]] = -stamp;
+        /* Unreached vertices, which are only left when disconnected, go after
+         * the component in the second part. */
+        for (n2=reached, i=lo; i < hi; i++)
+            if (mark[perm[i]] == stamp) {
+                queue[n2] = perm[i];
+                part[n2++] = 1;
+            }
+        for (v=j=0; j < 3; j++)
+            for (i=0; i < hi-lo; i++)
+                if (part[i] == j)
+                    perm[lo + v++] = queue[i];
+        for (n1=n2=i=0; i < hi-lo; i++) {
+            n1 += part[i] == 0;
+            n2 += part[i] == 1;
+        }
+        stack[sp++] = lo;
+        stack[sp++] = lo+n1;
+        stack[sp++] = lo+n1;
+        stack[sp++] = lo+n1+n2;
+    }
+    free(mark), free(level), free(queue), free(part), free(stack);
+}
+
+/* Lower triangle of P*A*P^T by columns: column j has the rows ci[cp[j] ..
+ * cp[j+1]) >= j, whose values are a->val[amap[..]]. */
+static void la_chol_lower(f, a)
+la_chol_d *f;
+la_csr_d *a;
+{
+    int n, i, ii, jj, *inv;
+    size_t k, p, *next;
+
+    n = a->rows;
+    inv = la_malloc(n, sizeof(int));
+    for (i=0; i < n; i++)
+        inv[f->perm[i]] = i;
+    free(f->cp), free(f->ci), free(f->amap);
+    f->cp = calloc((size_t)n+1, sizeof(size_t));
+    for (i=0; i < n; i++)
+        for (k=a->row_ptr[i]; k < a->row_ptr[i+1]; k++)
+            if ((ii = inv[i]) >= (jj = inv[a->col[k]]))
+                f->cp[jj+1]++;
+    for (i=0; i < n; i++)
+        f->cp[i+1] += f->cp[i];
+    f->ci = la_malloc(f->cp[n], sizeof(int));
+    f->amap = la_malloc(f->cp[n], sizeof(size_t));
+    next = la_malloc(n, sizeof(size_t));
+    memcpy(next, f->cp, sizeof(size_t) * n);
+    for (i=0; i < n; i++)
+        for (k=a->row_ptr[i]; k < a->row_ptr[i+1]; k++)
+            if ((ii = inv[i]) >= (jj = inv[a->col[k]])) {
+                p = next[jj]++;
+                f->ci[p] = ii;
+                f->amap[p] = k;
+            }
+    free(inv), free(next);
+}
+
+/* The same lower triangle by rows, the columns of row i in rj[rp[i] ..
+ * rp[i+1]) are < i. */
+static void la_chol_rows(f, rp, rj)
+la_chol_d *f;
+size_t **rp;
+int **rj;
+{
+    int n, i, j;
+    size_t p, *next;
+
+    n = f->n;
+    *rp = calloc((size_t)n+1, sizeof(size_t));
+    for (j=0; j < n; j++)
+        for (p=f->cp[j]; p < f->cp[j+1]; p++)
+            if (f->ci[p] > j)
+                (*rp)[f->ci[p]+1]++;
+    for (i=0; i < n; i++)
+        (*rp)[i+1] += (*rp)[i];
+    *rj = la_malloc((*rp)[n], sizeof(int));
+    next = la_malloc(n, sizeof(size_t));
+    memcpy(next, *rp, sizeof(size_t) * n);
+    for (j=0; j < n; j++)
+        for (p=f->cp[j]; p < f->cp[j+1]; p++)
+            if (f->ci[p] > j)
+                (*rj)[next[f->ci[p]]++] = j;
+    free(next);
+}
+
+/* Elimination tree by Liu's algorithm with path compression. */
+static void la_chol_etree(n, rp, rj, parent)
+size_t *rp;
+int *rj, *parent;
+{
+    int *ancestor, i, k, next;
+    size_t p;
+
+    ancestor = la_malloc(n, sizeof(int));
+    for (k=0; k < n; k++) {
+        parent[k] = ancestor[k] = -1;
+        for (p=rp[k]; p < rp[k+1]; p++)
+            for (i=rj[p]; i != -1 && i < k; i = next) {
+                next = ancestor[i];
+                ancestor[i] = k;
+                if (next == -1)
+                    parent[i] = k;
+            }
+    }
+    free(ancestor);
+}
+
+static int la_int_cmp(x, y)
+const void *x, *y;
+{
+    return *(int*)x - *(int*)y;
+}
+
+la_chol_analyze_d(a, f)
+la_csr_d *a;
+la_chol_d *f;
+{
+    int n, i, j, k, s, c, top, *parent, *head, *next, *stack, *post, *perm,
+        *cc, *snode, *shead, *snext, *mark;
+    size_t p, q, *rp, m;
+    int *rj, *r;
+
+    if (a->rows != a->cols)
+        return -1;
+    memset(f, 0, sizeof(*f));
+    f->n = n = a->rows;
+    f->perm = la_malloc(n, sizeof(int));
+    la_nd_order(a, f->perm);
+    /* Postorder the elimination tree, so that every supernode is a range of
+     * columns and the children come before their parent. */
+    parent = la_malloc(n, sizeof(int));
+    la_chol_lower(f, a);
+    la_chol_rows(f, &rp, &rj);
+    la_chol_etree(n, rp, rj, parent);
+    free(rp), free(rj);
+    head = la_malloc(n, sizeof(int));
+    next = la_malloc(n, sizeof(int));
+    stack = la_malloc(n, sizeof(int));
+    post = la_malloc(n, sizeof(int));
+    for (j=0; j < n; j++)
+        head[j] = -1;
+    for (j=n-1; j >= 0; j--)
+        if (parent[j] != -1) {
+            next[j] = head[parent[j]];
+            head[parent[j]] = j;
+        }
+    for (k=0, j=0; j < n; j++) {
+        if (parent[j] != -1)
+            continue;
+        stack[top=0] = j;
+        while (top >= 0) {
+            i = stack[top];
+            if ((c = head[i]) == -1) {
+                post[k++] = i;
+                top--;
+            } else {
+                head[i] = next[c];
+                stack[++top] = c;
+            }
+        }
+    }
+    perm = la_malloc(n, sizeof(int));
+    for (k=0; k < n; k++)
+        perm[k] = f->perm[post[k]];
+    free(f->perm);
+    f->perm = perm;
+    free(head), free(next), free(stack), free(post);
+    la_chol_lower(f, a);
+    la_chol_rows(f, &rp, &rj);
+    la_chol_etree(n, rp, rj, parent);
+    /* Column counts of L by the row subtrees. */
+    cc = la_malloc(n, sizeof(int));
+    mark = la_malloc(n, sizeof(int));
+    for (j=0; j < n; j++)
+        cc[j] = 1;
+    for (i=0; i < n; i++) {
+        mark[i] = i;
+        for (p=rp[i]; p < rp[i+1]; p++)
+            for (k=rj[p]; mark[k] != i; k = parent[k]) {
+                mark[k] = i;
+                cc[k]++;
+            }
+    }
+    free(rp), free(rj);
+    /* Fundamental supernodes: j joins the supernode of j-1 if it is the only
+     * child of j and their columns of L have the same pattern. */
+    head = calloc(n? n : 1, sizeof(int));
+    for (j=0; j < n; j++)
+        if (parent[j] != -1)
+            head[parent[j]]++;
+    f->super = la_malloc((size_t)n+1, sizeof(int));
+    snode = la_malloc(n, sizeof(int));
+    for (s=-1, j=0; j < n; j++) {
+        if (!j || parent[j-1] != j || cc[j-1] != cc[j]+1 || head[j] != 1)
+            f->super[++s] = j;
+        snode[j] = s;
+    }
+    f->nsuper = ++s;
+    f->super[s] = n;
+    free(head);
+    /* Rows of each supernode: its columns, then the rows below them of the
+     * columns of A and of the children. */
+    f->nchild = calloc(s? s : 1, sizeof(int));
+    f->row_ptr = la_malloc((size_t)s+1, sizeof(size_t));
+    f->val_ptr = la_malloc((size_t)s+1, sizeof(size_t));
+    f->row_ptr[0] = f->val_ptr[0] = 0;
+    for (s=0; s < f->nsuper; s++) {
+        m = cc[f->super[s]];
+        f->row_ptr[s+1] = f->row_ptr[s] + m;
+        f->val_ptr[s+1] = f->val_ptr[s] + m * (f->super[s+1] - f->super[s]);
+        if (m > f->maxfront)
+            f->maxfront = m;
+    }
+    f->rows = la_malloc(f->row_ptr[f->nsuper], sizeof(int));
+    shead = la_malloc(f->nsuper, sizeof(int));
+    snext = la_malloc(f->nsuper, sizeof(int));
+    for (s=0; s < f->nsuper; s++)
+        shead[s] = -1;
+    for (j=0; j < n; j++)
+        mark[j] = -1;
+    for (s=0; s < f->nsuper; s++) {
+        r = f->rows + f->row_ptr[s];
+        for (m=0, j=f->super[s]; j < f->super[s+1]; j++)
+            r[m++] = j;
+        j = f->super[s+1] - 1;
+        for (k=f->super[s]; k <= j; k++)
+            for (p=f->cp[k]; p < f->cp[k+1]; p++)
+                if (f->ci[p] > j && mark[f->ci[p]] != s) {
+                    mark[f->ci[p]] = s;
+                    r[m++] = f->ci[p];
+                }
+        for (c=shead[s]; c != -1; c = snext[c]) {
+            f->nchild[s]++;
+            for (q = f->row_ptr[c] + f->super[c+1] - f->super[c];
+                 q < f->row_ptr[c+1]; q++)
+                if (f->rows[q] > j && mark[f->rows[q]] != s) {
+                    mark[f->rows[q]] = s;
+                    r[m++] = f->rows[q];
+                }
+        }
+        assert(m == f->row_ptr[s+1] - f->row_ptr[s]);
+        qsort(r + f->super[s+1] - f->super[s], m - (f->super[s+1] - f->super[s]),
+              sizeof(int), la_int_cmp);
+        if (parent[j] != -1) {
+            c = snode[parent[j]];
+            snext[s] = shead[c];
+            shead[c] = s;
+        }
+    }
+    free(shead), free(snext), free(snode), free(mark), free(cc), free(parent);
+    /* The pattern analyzed, to recognize it. */
+    f->nnz = a->nnz;
+    f->a_row_ptr = la_malloc((size_t)n+1, sizeof(size_t));
+    memcpy(f->a_row_ptr, a->row_ptr, sizeof(size_t) * (n+1));
+    f->a_col = la_malloc(a->nnz, sizeof(int));
+    memcpy(f->a_col, a->col, sizeof(int) * a->nnz);
+    return 0;
+}
+
+la_chol_same_pattern_d(f, a)
+la_chol_d *f;
+la_csr_d *a;
+{
+    return f->n == a->rows && a->rows == a->cols && f->nnz == a->nnz &&
+           !memcmp(f->a_row_ptr, a->row_ptr, sizeof(size_t) * (f->n+1)) &&
+           !memcmp(f->a_col, a->col, sizeof(int) * a->nnz);
+}
+
+la_chol_factor_d(f, a, nthreads)
+la_chol_d *f;
+la_csr_d *a;
+{
+    int s, c, k, t, x, y, w, m, u, wc, info, top, *r, *rc, *relpos, *stack;
+    double *front, **update, *uc;
+    size_t p;
+
+    if (!f->val)
+        f->val = la_malloc(f->val_ptr[f->nsuper], sizeof(double));
+    relpos = la_malloc(f->n, sizeof(int));
+    stack = la_malloc(f->nsuper, sizeof(int));
+    update = la_malloc(f->nsuper, sizeof(double*));
+    front = la_aligned_alloc((size_t)f->maxfront * f->maxfront + 1, sizeof(double));
+    info = 0;
+    for (top=s=0; s < f->nsuper && !info; s++) {
+        r = f->rows + f->row_ptr[s];
+        m = f->row_ptr[s+1] - f->row_ptr[s];
+        w = f->super[s+1] - f->super[s];
+        memset(front, 0, sizeof(double) * m * m);
+        for (t=0; t < m; t++)
+            relpos[r[t]] = t;
+        /* Frontal matrix: the columns of A plus the updates of the children,
+         * which are on top of the stack in postorder. */
+        for (k=f->super[s]; k < f->super[s+1]; k++)
+            for (p=f->cp[k]; p < f->cp[k+1]; p++)
+                front[(size_t)relpos[f->ci[p]]*m + k - f->super[s]] +=
+                    a->val[f->amap[p]];
+        for (c=0; c < f->nchild[s]; c++) {
+            k = stack[--top];
+            rc = f->rows + f->row_ptr[k];
+            wc = f->super[k+1] - f->super[k];
+            u = f->row_ptr[k+1] - f->row_ptr[k] - wc;
+            uc = update[k];
+            /* The rows are sorted, so the lower triangle stays lower. */
+            for (x=0; x < u; x++)
+                for (y=0; y <= x; y++)
+                    front[(size_t)relpos[rc[wc+x]]*m + relpos[rc[wc+y]]] +=
+                        uc[(size_t)x*u + y];
+            free(uc);
+        }
+        if ((info = la_potrf_dag_d(m, w, front, m, 0, nthreads))) {
+            info += f->super[s];
+            break;
+        }
+        for (t=0; t < m; t++)
+            memcpy(f->val + f->val_ptr[s] + (size_t)t*w, front + (size_t)t*m,
+                   sizeof(double) * w);
+        if (m > w) {
+            u = m - w;
+            uc = update[s] = la_malloc((size_t)u*u, sizeof(double));
+            for (x=0; x < u; x++)
+                memcpy(uc + (size_t)x*u, front + (size_t)(w+x)*m + w,
+                       sizeof(double) * (x+1));
+            stack[top++] = s;
+        }
+    }
+    while (top)
+        free(update[stack[--top]]);
+    free(relpos), free(stack), free(update), free(front);
+    return info;
+}
+
+void la_chol_solve_d(f, b, x)
+la_chol_d *f;
+double *b, *x;
+{
+    int s, i, t, w, m, *r;
+    double *y, *tmp, *l;
+
+    y = la_malloc(f->n, sizeof(double));
+    tmp = la_malloc(f->maxfront, sizeof(double));
+    for (i=0; i < f->n; i++)
+        y[i] = b[f->perm[i]];
+    /* L*z = P*b, by supernodes. */
+    for (s=0; s < f->nsuper; s++) {
+        r = f->rows + f->row_ptr[s];
+        m = f->row_ptr[s+1] - f->row_ptr[s];
+        w = f->super[s+1] - f->super[s];
+        l = f->val + f->val_ptr[s];
+        cblas_dtrsv(CblasRowMajor, CblasLower, CblasNoTrans, CblasNonUnit, w, l,
+                    w, y + f->super[s], 1);
+        if (m == w)
+            continue;
+        cblas_dgemv(CblasRowMajor, CblasNoTrans, m-w, w, 1.0, l + (size_t)w*w,
+                    w, y + f->super[s], 1, 0.0, tmp, 1);
+        for (t=w; t < m; t++)
+            y[r[t]] -= tmp[t-w];
+    }
+    /* L^T*P*x = z, backwards. */
+    for (s=f->nsuper-1; s >= 0; s--) {
+        r = f->rows + f->row_ptr[s];
+        m = f->row_ptr[s+1] - f->row_ptr[s];
+        w = f->super[s+1] - f->super[s];
+        l = f->val + f->val_ptr[s];
+        if (m > w) {
+            for (t=w; t < m; t++)
+                tmp[t-w] = y[r[t]];
+            cblas_dgemv(CblasRowMajor, CblasTrans, m-w, w, -1.0, l + (size_t)w*w,
+                        w, tmp, 1, 1.0, y + f->super[s], 1);
+        }
+        cblas_dtrsv(CblasRowMajor, CblasLower, CblasTrans, CblasNonUnit, w, l,
+                    w, y + f->super[s], 1);
+    }
+    for (i=0; i < f->n; i++)
+        x[f->perm[i]] = y[i];
+    free(y), free(tmp);
+}
+
+void la_free_chol_d(f)
+la_chol_d *f;
+{
+    free(f->perm), free(f->super), free(f->nchild), free(f->row_ptr);
+    free(f->rows), free(f->val_ptr), free(f->val);
+    free(f->cp), free(f->ci), free(f->amap);
+    free(f->a_row_ptr), free(f->a_col);
+    memset(f, 0, sizeof(*f));
+}
+
+/* Householder reflector H = I - tau*v*v^T with H*x = (beta, 0, ..., 0)^T for
+ * the n elements of x: v(0) is 1, the rest of v overwrites x(1..n-1) and
+ * beta overwrites x(0). Return tau, zero if x is already so. */
+static double la_larfg_d(n, x)
+double *x;
+{
+    double alpha, xnorm, beta;
+
+    xnorm = n > 1? cblas_dnrm2(n-1, x+1, 1) : 0;
+    if (!xnorm)
+        return 0;
+    alpha = x[0];
+    beta = -copysign(hypot(alpha, xnorm), alpha);
+    cblas_dscal(n-1, 1 / (alpha-beta), x+1, 1);
+    x[0] = beta;
+    return (beta-alpha) / beta;
+}
+
+/* C = C*H for the m x n matrix C and H = I - tau*v*v^T, work has m
+ * elements. */
+static void la_larf_right_d(m, n, v, tau, c, ldc, work)
+double *v, tau, *c, *work;
+{
+    if (!tau || !m)
+        return;
+    cblas_dgemv(CblasRowMajor, CblasNoTrans, m, n, 1.0, c, ldc, v, 1, 0.0,
+                work, 1);
+    cblas_dger(CblasRowMajor, m, n, -tau, work, 1, v, 1, c, ldc);
+}
+
+/* Unblocked la_gelqf_d() of an m x n panel, work has m elements. */
+static void la_gelq2_d(m, n, a, lda, tau, work)
+double *a, *tau, *work;
+{
+    int i, k;
+    double aii, *ai;
+
+    k = m < n? m : n;
+    for (i=0; i < k; i++) {
+        ai = a + (size_t)i*lda + i;
+        tau[i] = la_larfg_d(n-i, ai);
+        aii = *ai;
+        *ai = 1;
+        la_larf_right_d(m-i-1, n-i, ai, tau[i], ai + lda, lda, work);
+        *ai = aii;
+    }
+}
+
+/* Upper triangular k x k T of H(0)*H(1)*...*H(k-1) = I - V^T*T*V, the rows
+ * of V being the k reflectors stored at the right of the diagonal of v. */
+static void la_larft_d(k, n, v, ldv, tau, t, ldt)
+double *v, *tau, *t;
+{
+    int i;
+    double vii;
+
+    for (i=0; i < k; i++) {
+        vii = v[(size_t)i*ldv + i];
+        v[(size_t)i*ldv + i] = 1;
+        if (i) {
+            cblas_dgemv(CblasRowMajor, CblasNoTrans, i, n-i, -tau[i], v + i,
+                        ldv, v + (size_t)i*ldv + i, 1, 0.0, t + i, ldt);
+            cblas_dtrmv(CblasRowMajor, CblasUpper, CblasNoTrans, CblasNonUnit,
+                        i, t, ldt, t + i, ldt);
+        }
+        t[(size_t)i*ldt + i] = tau[i];
+        v[(size_t)i*ldv + i] = vii;
+    }
+}
+
+/* C = C*(I - V^T*op(T)*V) for the m x n matrix C, op(T) is T^T if trans. The
+ * two products with V, the k x n reflectors of la_larft_d(), are GEMMs by
+ * nthreads threads. */
+static void la_larfb_d(trans, m, n, k, v, ldv, t, ldt, c, ldc, nthreads)
+double *v, *t, *c;
+{
+    int i, j;
+    double *vw, *w;
+
+    if (!m || !k)
+        return;
+    /* V with its zeros and unit diagonal, for GEMM. */
+    vw = malloc(sizeof(double) * (size_t)k * n);
+    w = malloc(sizeof(double) * (size_t)m * k);
+    for (i=0; i < k; i++) {
+        for (j=0; j < i; j++)
+            vw[(size_t)i*n + j] = 0;
+        vw[(size_t)i*n + i] = 1;
+        memcpy(vw + (size_t)i*n + i+1, v + (size_t)i*ldv + i+1,
+               sizeof(double) * (n-i-1));
+    }
+    la_gemm_parallel_d(1, m, k, n, 1.0, c, ldc, vw, n, 0.0, w, k, nthreads);
+    cblas_dtrmm(CblasRowMajor, CblasRight, CblasUpper,
+                trans? CblasTrans : CblasNoTrans, CblasNonUnit, m, k, 1.0, t,
+                ldt, w, k);
+    la_gemm_parallel_d(0, m, n, k, -1.0, w, k, vw, n, 1.0, c, ldc, nthreads);
+    free(vw), free(w);
+}
+
+void la_gelqf_d(m, n, a, lda, tau, nthreads)
+double *a, *tau;
+{
+    int i, k, ib;
+    double *t, *work, *ai;
+
+    k = m < n? m : n;
+    t = malloc(sizeof(double) * LA_BLOCK * LA_BLOCK);
+    work = malloc(sizeof(double) * (m? m : 1));
+    for (i=0; i < k; i += LA_BLOCK) {
+        ib = k - i < LA_BLOCK? k - i : LA_BLOCK;
+        ai = a + (size_t)i*lda + i;
+        la_gelq2_d(ib, n-i, ai, lda, tau+i, work);
+        if (i+ib < m) {
+            la_larft_d(ib, n-i, ai, lda, tau+i, t, LA_BLOCK);
+            la_larfb_d(0, m-i-ib, n-i, ib, ai, lda, t, LA_BLOCK,
+                       ai + (size_t)ib*lda, lda, nthreads);
+        }
+    }
+    free(t), free(work);
+}
+
+/* Unblocked la_orglq_d() of an m x n panel, work has m elements. */
+static void la_orgl2_d(m, n, a, lda, tau, work)
+double *a, *tau, *work;
+{
+    int i;
+    double *ai;
+
+    for (i=m-1; i >= 0; i--) {
+        ai = a + (size_t)i*lda;
+        if (i < n-1) {
+            ai[i] = 1;
+            la_larf_right_d(m-i-1, n-i, ai+i, tau[i], ai + lda + i, lda, work);
+            cblas_dscal(n-i-1, -tau[i], ai+i+1, 1);
+        }
+        ai[i] = 1 - tau[i];
+        memset(ai, 0, sizeof(double) * i);
+    }
+}
+
+void la_orglq_d(m, n, a, lda, tau, nthreads)
+double *a, *tau;
+{
+    int i, ib;
+    double *t, *work, *ai;
+
+    if (!m)
+        return;
+    t = malloc(sizeof(double) * LA_BLOCK * LA_BLOCK);
+    work = malloc(sizeof(double) * m);
+    for (i = (m-1) / LA_BLOCK * LA_BLOCK; i >= 0; i -= LA_BLOCK) {
+        ib = m - i < LA_BLOCK? m - i : LA_BLOCK;
+        ai = a + (size_t)i*lda + i;
+        /* The rows below already hold Q, zero at the left of column i+ib. */
+        if (i+ib < m) {
+            la_larft_d(ib, n-i, ai, lda, tau+i, t, LA_BLOCK);
+            la_larfb_d(1, m-i-ib, n-i, ib, ai, lda, t, LA_BLOCK,
+                       ai + (size_t)ib*lda, lda, nthreads);
+        }
+        la_orgl2_d(ib, n-i, ai, lda, tau+i, work);
+        for (; ai < a + (size_t)(i+ib)*lda; ai += lda)
+            memset(ai - i, 0, sizeof(double) * i);
+    }
+    free(t), free(work);
+}
+
+/* Sweeps of la_syev_jacobi_d() before giving up on convergence. */
+#define LA_JACOBI_SWEEPS 100
+
+la_syev_jacobi_d(n, a, lda, w, v, ldv)
+double *a, *w, *v;
+{
+    int p, q, r, o, sweep, *order;
+    double off, norm, theta, t, c, s, apr, aqr, *tmp;
+
+    for (p=0; p < n; p++)
+        for (q=0; q < n; q++)
+            v[(size_t)p*ldv + q] = p == q;
+    for (norm=p=0; p < n; p++)
+        for (q=0; q < n; q++)
+            norm += a[(size_t)p*lda + q] * a[(size_t)p*lda + q];
+    for (sweep=0; sweep < LA_JACOBI_SWEEPS; sweep++) {
+        for (off=p=0; p < n; p++)
+            for (q=p+1; q < n; q++)
+                off += a[(size_t)p*lda + q] * a[(size_t)p*lda + q];
+        if (!(2*off > DBL_EPSILON * DBL_EPSILON * norm))
+            break;
+        /* One rotation on the rows and columns p and q zeroes a[p][q]. */
+        for (p=0; p < n; p++)
+            for (q=p+1; q < n; q++) {
+                if (!a[(size_t)p*lda + q])
+                    continue;
+                theta = (a[(size_t)q*lda + q] - a[(size_t)p*lda + p]) /
+                        (2 * a[(size_t)p*lda + q]);
+                t = (theta < 0? -1 : 1) / (fabs(theta) + sqrt(theta*theta + 1));
+                c = 1 / sqrt(t*t + 1);
+                s = t*c;
+                a[(size_t)p*lda + p] -= t * a[(size_t)p*lda + q];
+                a[(size_t)q*lda + q] += t * a[(size_t)p*lda + q];
+                a[(size_t)p*lda + q] = a[(size_t)q*lda + p] = 0;
+                for (r=0; r < n; r++) {
+                    if (r != p && r != q) {
+                        apr = a[(size_t)p*lda + r];
+                        aqr = a[(size_t)q*lda + r];
+                        a[(size_t)p*lda + r] = a[(size_t)r*lda + p] = c*apr - s*aqr;
+                        a[(size_t)q*lda + r] = a[(size_t)r*lda + q] = s*apr + c*aqr;
+                    }
+                    apr = v[(size_t)p*ldv + r];
+                    aqr = v[(size_t)q*ldv + r];
+                    v[(size_t)p*ldv + r] = c*apr - s*aqr;
+                    v[(size_t)q*ldv + r] = s*apr + c*aqr;
+                }
+            }
+    }
+    /* Decreasing order, by a selection of the rows of v. */
+    order = la_malloc(n, sizeof(int));
+    tmp = la_malloc(n, sizeof(double));
+    for (p=0; p < n; p++)
+        order[p] = p;
+    for (p=0; p < n; p++) {
+        for (r=q=p; q < n; q++)
+            if (a[(size_t)order[q]*lda + order[q]] > a[(size_t)order[r]*lda + order[r]])
+                r = q;
+        o = order[p], order[p] = order[r], order[r] = o;
+        w[p] = a[(size_t)order[p]*lda + order[p]];
+    }
+    for (p=0; p < n; p++) {
+        /* Follow the cycle of p, marking the rows moved. */
+        if (order[p] < 0)
+            continue;
+        memcpy(tmp, v + (size_t)p*ldv, sizeof(double) * n);
+        for (q=p; order[q] != p; q = r) {
+            r = order[q];
+            memcpy(v + (size_t)q*ldv, v + (size_t)r*ldv, sizeof(double) * n);
+            order[q] = -1;
+        }
+        memcpy(v + (size_t)q*ldv, tmp, sizeof(double) * n);
+        order[q] = -1;
+    }
+    free(order), free(tmp);
+    return sweep < LA_JACOBI_SWEEPS? 0 : -1;
+}
+
+static void la_vector_sums_generic(n, x, y, sums)
+double *x, *y, *sums;
+{
+    double acc[4][4], d;
+    int i, j;
+
+    memset(acc, 0, sizeof(acc));
+    for (i=0; i+4 <= n; i += 4)
+        for (j=0; j < 4; j++) {
+            d = x[i+j] - y[i+j];
+            acc[0][j] += x[i+j] * y[i+j];
+            acc[1][j] += x[i+j] * x[i+j];
+            acc[2][j] += y[i+j] * y[i+j];
+            acc[3][j] += d * d;
+        }
+    for (; i < n; i++) {
+        d = x[i] - y[i];
+        acc[0][0] += x[i] * y[i];
+        acc[1][0] += x[i] * x[i];
+        acc[2][0] += y[i] * y[i];
+        acc[3][0] += d * d;
+    }
+    for (i=0; i < 4; i++)
+        sums[i] += acc[i][0] + acc[i][1] + acc[i][2] + acc[i][3];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2,fma")))
+static void la_vector_sums_avx2(n, x, y, sums)
+double *x, *y, *sums;
+{
+    __m256d acc[4][2], a, b, d;
+    double lane[4];
+    int i, j, k;
+
+    for (k=0; k < 4; k++)
+        acc[k][0] = acc[k][1] = _mm256_setzero_pd();
+    for (i=0; i+8 <= n; i += 8)
+#pragma GCC unroll 2
+        for (j=0; j < 2; j++) {
+            a = _mm256_loadu_pd(x + i + 4*j);
+            b = _mm256_loadu_pd(y + i + 4*j);
+            d = _mm256_sub_pd(a, b);
+            acc[0][j] = _mm256_fmadd_pd(a, b, acc[0][j]);
+            acc[1][j] = _mm256_fmadd_pd(a, a, acc[1][j]);
+            acc[2][j] = _mm256_fmadd_pd(b, b, acc[2][j]);
+            acc[3][j] = _mm256_fmadd_pd(d, d, acc[3][j]);
+        }
+    for (k=0; k < 4; k++) {
+        _mm256_storeu_pd(lane, _mm256_add_pd(acc[k][0], acc[k][1]));
+        sums[k] += lane[0] + lane[1] + lane[2] + lane[3];
+    }
+    la_vector_sums_generic(n-i, x+i, y+i, sums);
+}
+
+#endif
+
+static void (*la_vector_sums_kernel)() = la_vector_sums_generic;
+static pthread_once_t la_vector_sums_once = PTHREAD_ONCE_INIT;
+
+static void la_vector_sums_select()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        la_vector_sums_kernel = la_vector_sums_avx2;
+#endif
+}
+
+void la_vector_sums_d(n, x, y, sums)
+double *x, *y, *sums;
+{
+    pthread_once(&la_vector_sums_once, la_vector_sums_select);
+    la_vector_sums_kernel(n, x, y, sums);
+}
+
+/* Longest number read by la_read_vector_chunk_d(), the rest is ignored. */
+#define LA_TOKEN 64
+
+la_read_vector_chunk_d(stream, x, max)
+FILE *stream;
+double *x;
+{
+    char token[LA_TOKEN], *end;
+    int c, n, len;
+
+    for (n=0; n < max; n++) {
+        while ((c = getc_unlocked(stream)) != EOF && c != '\n' && LA_IS_SPACE(c))
+            ;
+        if (c == EOF || c == '\n')
+            break;
+        for (len=0; c != EOF && !LA_IS_SPACE(c); c = getc_unlocked(stream))
+            if (len < LA_TOKEN-1)
+                token[len++] = c;
+        token[len] = '\0';
+        x[n] = la_strtod(token, &end);
+        if (end == token)
+            x[n] = 0;
+        if (c == '\n')
+            ungetc(c, stream);
+    }
+    return n;
+}
+
+/* Products below it are summed by one thread in la_frobenius_d(). */
+#define LA_PARALLEL_FROBENIUS (1 << 16)
+
+/* Compensated dot product of n elements, Dot2 of Ogita, Rump and Oishi: the
+ * rounding errors of each product, by FMA, and of each sum are added apart,
+ * so the result is as if computed in twice the precision. sum[0] gets the
+ * sum and sum[1] the error. */
+static void la_dot2_generic(n, x, y, sum)
+double *x, *y, *sum;
+{
+    double s[4], c[4], p, t, z;
+    int i, j;
+
+    memset(s, 0, sizeof(s));
+    memset(c, 0, sizeof(c));
+    for (i=0; i+4 <= n; i += 4)
+        for (j=0; j < 4; j++) {
+            p = x[i+j] * y[i+j];
+            t = s[j] + p;
+            z = t - s[j];
+            c[j] += fma(x[i+j], y[i+j], -p) + ((s[j] - (t-z)) + (p-z));
+            s[j] = t;
+        }
+    for (; i < n; i++) {
+        p = x[i] * y[i];
+        t = s[0] + p;
+        z = t - s[0];
+        c[0] += fma(x[i], y[i], -p) + ((s[0] - (t-z)) + (p-z));
+        s[0] = t;
+    }
+    sum[0] = s[0] + s[1] + s[2] + s[3];
+    sum[1] = c[0] + c[1] + c[2] + c[3];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2,fma"), optimize("fp-contract=off")))
+static void la_dot2_avx2(n, x, y, sum)
+double *x, *y, *sum;
+{
+    __m256d s, c, a, b, p, t, z;
+    double ls[4], lc[4], tail[2];
+    int i;
+
+    s = c = _mm256_setzero_pd();
+    for (i=0; i+4 <= n; i += 4) {
+        a = _mm256_loadu_pd(x+i);
+        b = _mm256_loadu_pd(y+i);
+        p = _mm256_mul_pd(a, b);
+        t = _mm256_add_pd(s, p);
+        z = _mm256_sub_pd(t, s);
+        c = _mm256_add_pd(c, _mm256_add_pd(_mm256_fmsub_pd(a, b, p),
+            _mm256_add_pd(_mm256_sub_pd(s, _mm256_sub_pd(t, z)), _mm256_sub_pd(p, z))));
+        s = t;
+    }
+    _mm256_storeu_pd(ls, s);
+    _mm256_storeu_pd(lc, c);
+    la_dot2_generic(n-i, x+i, y+i, tail);
+    sum[0] = ls[0] + ls[1] + ls[2] + ls[3] + tail[0];
+    sum[1] = lc[0] + lc[1] + lc[2] + lc[3] + tail[1];
+}
+
+#endif
+
+static void (*la_dot2_kernel)() = la_dot2_generic;
+static pthread_once_t la_dot2_once = PTHREAD_ONCE_INIT;
+
+static void la_dot2_select()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        la_dot2_kernel = la_dot2_avx2;
+#endif
+}
+
+struct la_frobenius_args {
+    int n, lda, ldb;
+    double *a, *b, *sums;
+};
+
+static void la_frobenius_rows_d(p, begin, end)
+struct la_frobenius_args *p;
+{
+    int i;
+
+    for (i=begin; i < end; i++)
+        la_dot2_kernel(p->n, p->a + (size_t)i*p->lda, p->b + (size_t)i*p->ldb,
+                       p->sums + 2*(size_t)i);
+}
+
+double la_frobenius_d(m, n, a, lda, b, ldb, nthreads)
+double *a, *b;
+{
+    struct la_frobenius_args p;
+    double s, c, t;
+    int i;
+
+    if (m <= 0 || n <= 0)
+        return 0;
+    pthread_once(&la_dot2_once, la_dot2_select);
+    p.n = n, p.a = a, p.lda = lda, p.b = b, p.ldb = ldb;
+    p.sums = malloc(sizeof(double) * 2 * (size_t)m);
+    la_parallel((double)m*n < LA_PARALLEL_FROBENIUS? 1 : nthreads, m,
+                la_frobenius_rows_d, &p);
+    /* Neumaier's summation of the rows, with their errors. */
+    for (s=c=i=0; i < m; i++) {
+        t = s + p.sums[2*i];
+        if (fabs(s) >= fabs(p.sums[2*i]))
+            c += (s-t) + p.sums[2*i];
+        else
+            c += (p.sums[2*i]-t) + s;
+        s = t;
+        c += p.sums[2*i+1];
+    }
+    free(p.sums);
+    return s + c;
+}
+
+/* Four doubles, one matrix per lane of the closed-form determinants. */
+typedef double la_v4d __attribute__((vector_size(32)));
+
+/* Determinants of four n x n matrices, n <= 4, from their elements in
+ * structure-of-arrays layout: m[e] has element e of each one. */
+static inline void la_det_lanes(n, m, d)
+la_v4d *m, *d;
+{
+    la_v4d c[6], s[6];
+
+    switch (n) {
+    case 1:
+        *d = m[0];
+        return;
+    case 2:
+        *d = m[0]*m[3] - m[1]*m[2];
+        return;
+    case 3:
+        *d = m[0]*(m[4]*m[8] - m[5]*m[7]) - m[1]*(m[3]*m[8] - m[5]*m[6]) +
+             m[2]*(m[3]*m[7] - m[4]*m[6]);
+        return;
+    }
+    /* Laplace expansion by the 2 x 2 minors of the first two rows and of the
+     * last two. */
+    c[0] = m[0]*m[5] - m[1]*m[4];
+    c[1] = m[0]*m[6] - m[2]*m[4];
+    c[2] = m[0]*m[7] - m[3]*m[4];
+    c[3] = m[1]*m[6] - m[2]*m[5];
+    c[4] = m[1]*m[7] - m[3]*m[5];
+    c[5] = m[2]*m[7] - m[3]*m[6];
+    s[0] = m[8]*m[13] - m[9]*m[12];
+    s[1] = m[8]*m[14] - m[10]*m[12];
+    s[2] = m[8]*m[15] - m[11]*m[12];
+    s[3] = m[9]*m[14] - m[10]*m[13];
+    s[4] = m[9]*m[15] - m[11]*m[13];
+    s[5] = m[10]*m[15] - m[11]*m[14];
+    *d = c[0]*s[5] - c[1]*s[4] + c[2]*s[3] + c[3]*s[2] - c[4]*s[1] + c[5]*s[0];
+}
+
+/* Closed forms for n <= 4, four matrices at a time. The last group repeats
+ * the last matrix in its empty lanes. */
+__attribute__((target_clones("avx2", "default")))
+static void la_det_small_d(count, n, a, lda, stride, det)
+double *a, *det;
+size_t stride;
+{
+    la_v4d m[16], d;
+    int p, l, e, nn;
+    size_t q[4], off[16];
+
+    nn = n*n;
+    for (e=0; e < nn; e++)
+        off[e] = (size_t)(e/n)*lda + e%n;
+    for (p=0; p < count; p += 4) {
+        for (l=0; l < 4; l++)
+            q[l] = (size_t)(p+l < count? p+l : count-1) * stride;
+        for (e=0; e < nn; e++)
+            m[e] = (la_v4d){a[q[0]+off[e]], a[q[1]+off[e]], a[q[2]+off[e]],
+                            a[q[3]+off[e]]};
+        la_det_lanes(n, m, &d);
+        for (l=0; l < 4 && p+l < count; l++)
+            det[p+l] = d[l];
+    }
+}
+
+void la_det_batch_d(count, n, a, lda, stride, det)
+double *a, *det;
+size_t stride;
+{
+    double *lu, log_det;
+    int p, i, j, sign, *ipiv;
+
+    if (n <= 4) {
+        if (n <= 0)
+            for (p=0; p < count; p++)
+                det[p] = 1;
+        else
+            la_det_small_d(count, n, a, lda, stride, det);
+        return;
+    }
+    lu = malloc(sizeof(double) * n * n);
+    ipiv = malloc(sizeof(int) * n);
+    for (p=0; p < count; p++) {
+        for (i=0; i < n; i++)
+            for (j=0; j < n; j++)
+                lu[i*n + j] = a[p*stride + (size_t)i*lda + j];
+        la_getrf_d(n, n, lu, n, ipiv);
+        log_det = la_log_det_d(n, lu, n, ipiv, &sign);
+        det[p] = sign? sign * exp(log_det) : 0;
+    }
+    free(lu), free(ipiv);
+}
+
+/* Inverses of four n x n matrices, n <= 4, in the layout of
+ * la_det_lanes(): the adjugate over the determinant. det gets the
+ * determinants. */
+static inline void la_inv_lanes(n, m, b, det)
+la_v4d *m, *b, *det;
+{
+    la_v4d s[6], c[6], r;
+
+    switch (n) {
+    case 1:
+        *det = m[0];
+        b[0] = 1 / m[0];
+        return;
+    case 2:
+        *det = m[0]*m[3] - m[1]*m[2];
+        r = 1 / *det;
+        b[0] = m[3]*r, b[1] = -m[1]*r;
+        b[2] = -m[2]*r, b[3] = m[0]*r;
+        return;
+    case 3:
+        b[0] = m[4]*m[8] - m[5]*m[7];
+        b[3] = m[5]*m[6] - m[3]*m[8];
+        b[6] = m[3]*m[7] - m[4]*m[6];
+        *det = m[0]*b[0] + m[1]*b[3] + m[2]*b[6];
+        r = 1 / *det;
+        b[0] *= r, b[3] *= r, b[6] *= r;
+        b[1] = (m[2]*m[7] - m[1]*m[8]) * r;
+        b[2] = (m[1]*m[5] - m[2]*m[4]) * r;
+        b[4] = (m[0]*m[8] - m[2]*m[6]) * r;
+        b[5] = (m[2]*m[3] - m[0]*m[5]) * r;
+        b[7] = (m[1]*m[6] - m[0]*m[7]) * r;
+        b[8] = (m[0]*m[4] - m[1]*m[3]) * r;
+        return;
+    }
+    /* The 2 x 2 minors of the first two rows and of the last two. */
+    s[0] = m[0]*m[5] - m[1]*m[4];
+    s[1] = m[0]*m[6] - m[2]*m[4];
+    s[2] = m[0]*m[7] - m[3]*m[4];
+    s[3] = m[1]*m[6] - m[2]*m[5];
+    s[4] = m[1]*m[7] - m[3]*m[5];
+    s[5] = m[2]*m[7] - m[3]*m[6];
+    c[0] = m[8]*m[13] - m[9]*m[12];
+    c[1] = m[8]*m[14] - m[10]*m[12];
+    c[2] = m[8]*m[15] - m[11]*m[12];
+    c[3] = m[9]*m[14] - m[10]*m[13];
+    c[4] = m[9]*m[15] - m[11]*m[13];
+    c[5] = m[10]*m[15] - m[11]*m[14];
+    *det = s[0]*c[5] - s[1]*c[4] + s[2]*c[3] + s[3]*c[2] - s[4]*c[1] + s[5]*c[0];
+    r = 1 / *det;
+    b[0] = (m[5]*c[5] - m[6]*c[4] + m[7]*c[3]) * r;
+    b[1] = (-m[1]*c[5] + m[2]*c[4] - m[3]*c[3]) * r;
+    b[2] = (m[13]*s[5] - m[14]*s[4] + m[15]*s[3]) * r;
+    b[3] = (-m[9]*s[5] + m[10]*s[4] - m[11]*s[3]) * r;
+    b[4] = (-m[4]*c[5] + m[6]*c[2] - m[7]*c[1]) * r;
+    b[5] = (m[0]*c[5] - m[2]*c[2] + m[3]*c[1]) * r;
+    b[6] = (-m[12]*s[5] + m[14]*s[2] - m[15]*s[1]) * r;
+    b[7] = (m[8]*s[5] - m[10]*s[2] + m[11]*s[1]) * r;
+    b[8] = (m[4]*c[4] - m[5]*c[2] + m[7]*c[0]) * r;
+    b[9] = (-m[0]*c[4] + m[1]*c[2] - m[3]*c[0]) * r;
+    b[10] = (m[12]*s[4] - m[13]*s[2] + m[15]*s[0]) * r;
+    b[11] = (-m[8]*s[4] + m[9]*s[2] - m[11]*s[0]) * r;
+    b[12] = (-m[4]*c[3] + m[5]*c[1] - m[6]*c[0]) * r;
+    b[13] = (m[0]*c[3] - m[1]*c[1] + m[2]*c[0]) * r;
+    b[14] = (-m[12]*s[3] + m[13]*s[1] - m[14]*s[0]) * r;
+    b[15] = (m[8]*s[3] - m[9]*s[1] + m[10]*s[0]) * r;
+}
+
+/* Closed forms for n <= 4, four matrices at a time as in la_det_small_d(). */
+__attribute__((target_clones("avx2", "default")))
+static void la_inv_small_d(count, n, a, lda, stride, inv, singular)
+double *a, *inv;
+size_t stride;
+int *singular;
+{
+    la_v4d m[16], b[16], det;
+    int p, l, e, nn;
+    size_t q[4], off[16];
+
+    nn = n*n;
+    for (e=0; e < nn; e++)
+        off[e] = (size_t)(e/n)*lda + e%n;
+    for (p=0; p < count; p += 4) {
+        for (l=0; l < 4; l++)
+            q[l] = (size_t)(p+l < count? p+l : count-1) * stride;
+        for (e=0; e < nn; e++)
+            m[e] = (la_v4d){a[q[0]+off[e]], a[q[1]+off[e]], a[q[2]+off[e]],
+                            a[q[3]+off[e]]};
+        la_inv_lanes(n, m, b, &det);
+        for (l=0; l < 4 && p+l < count; l++) {
+            singular[p+l] = !(det[l] != 0 && isfinite(det[l]));
+            for (e=0; e < nn; e++)
+                inv[(size_t)(p+l)*nn + e] = singular[p+l]? NAN : b[e][l];
+        }
+    }
+}
+
+void la_inv_batch_d(count, n, a, lda, stride, inv, singular)
+double *a, *inv;
+size_t stride;
+int *singular;
+{
+    double *x;
+    int p, i, j, *ipiv;
+
+    if (n <= 0) {
+        memset(singular, 0, sizeof(int) * count);
+        return;
+    }
+    if (n <= 4) {
+        la_inv_small_d(count, n, a, lda, stride, inv, singular);
+        return;
+    }
+    ipiv = malloc(sizeof(int) * n);
+    for (p=0; p < count; p++) {
+        x = inv + (size_t)p*n*n;
+        for (i=0; i < n; i++)
+            for (j=0; j < n; j++)
+                x[i*n + j] = a[p*stride + (size_t)i*lda + j];
+        if ((singular[p] = la_getrf_d(n, n, x, n, ipiv) ||
+                           la_getri_d(n, x, n, ipiv, 1)))
+            for (i=0; i < n*n; i++)
+                x[i] = NAN;
+    }
+    free(ipiv);
+}
+
+void la_allocate_batch_d(b, max)
+la_batch_d *b;
+{
+    memset(b, 0, sizeof(*b));
+    la_allocate_matrix_d(&b->m, 0, 0);
+    b->max = max < 1? 1 : max;
+}
+
+la_read_batch_d(stream, b)
+FILE *stream;
+la_batch_d *b;
+{
+    la_matrix_d *m;
+    size_t size;
+    int n, i, j;
+
+    m = &b->m;
+    b->count = 0;
+    if (b->done)
+        return 0;
+    if (!b->pending && la_peek(stream) == 0x93) {
+        /* Each array of the stream is a batch, read in place. */
+        la_read_matrix_d(stream, m);
+        if (!(n = m->cols) || m->rows % n) {
+            fputs("[la_read_batch_d] The rows are not a stack of square matrices.\n",
+                  stderr);
+            b->done = 1;
+            return -1;
+        }
+        if (!m->rows)
+            return la_read_batch_d(stream, b);
+        b->base = m->base;
+        b->n = n;
+        b->lda = m->lda;
+        b->stride = (size_t)n * m->lda;
+        return b->count = m->rows / n;
+    }
+    for (;;) {
+        /* The matrix that ended the last batch starts this one. */
+        if (!b->pending) {
+            /* An array after the matrices of the batch is the next one. */
+            if (b->count && la_peek(stream) == 0x93)
+                break;
+            la_read_matrix_d(stream, m);
+        }
+        b->pending = 0;
+        if (m->rows != m->cols) {
+            fputs("[la_read_batch_d] The matrix is not square.\n", stderr);
+            b->done = 1;
+            return -1;
+        }
+        if (!m->rows) {
+            b->done = 1;
+            break;
+        }
+        if (b->count && (m->rows != b->n || b->count == b->max)) {
+            b->pending = 1;
+            break;
+        }
+        n = b->n = m->rows;
+        size = (size_t)(b->count+1) * n*n;
+        if (size > b->capacity) {
+            b->capacity = size > 2*b->capacity? size : 2*b->capacity;
+            b->stack = realloc(b->stack, sizeof(double) * b->capacity);
+        }
+        for (i=0; i < n; i++)
+            for (j=0; j < n; j++)
+                b->stack[(size_t)b->count*n*n + i*n + j] = LA_AT(m, i, j);
+        b->count++;
+    }
+    b->base = b->stack;
+    b->lda = b->n;
+    b->stride = (size_t)b->n * b->n;
+    return b->count;
+}
+
+void la_free_batch_d(b)
+la_batch_d *b;
+{
+    la_free_matrix_d(&b->m);
+    free(b->stack);
+    memset(b, 0, sizeof(*b));
+}
+
+/* First element of panel j of an out-of-core matrix. */
+#define LA_OOC_PANEL(F, J) ((F)->map + (size_t)(J) * (F)->nt*(F)->nb * (F)->nb)
+
+la_ooc_create_d(f, path, n, nb)
+la_ooc_d *f;
+char *path;
+{
+    int fd, i;
+
+    memset(f, 0, sizeof(*f));
+    f->n = n;
+    f->nb = nb = nb < 1? 1 : nb;
+    f->nt = n? (n + nb-1) / nb : 1;
+    f->size = sizeof(double) * (size_t)f->nt*nb * f->nt*nb;
+    if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600)) < 0) {
+        perror(path);
+        return -1;
+    }
+    /* The file goes away with the mapping. */
+    unlink(path);
+    if (ftruncate(fd, f->size) ||
+        (f->map = mmap(NULL, f->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                       0)) == MAP_FAILED) {
+        perror(path);
+        close(fd);
+        f->map = NULL;
+        return -1;
+    }
+    close(fd);
+    for (i=n; i < f->nt*nb; i++)
+        LA_OOC_AT(f, i, i) = 1;
+    f->ipiv = la_malloc(f->nt*nb, sizeof(int));
+    return 0;
+}
+
+void la_free_ooc_d(f)
+la_ooc_d *f;
+{
+    if (f->map)
+        munmap(f->map, f->size);
+    free(f->ipiv);
+    memset(f, 0, sizeof(*f));
+}
+
+/* Put the values of row i from column j on of a row in the out-of-core
+ * matrix, the ones past column n in rest. */
+static void la_ooc_put_row_d(f, i, j, x, count, rest)
+la_ooc_d *f;
+double *x;
+la_matrix_d *rest;
+{
+    for (; count--; j++, x++)
+        if (j < f->n)
+            LA_OOC_AT(f, i, j) = *x;
+        else
+            LA_AT(rest, i, j - f->n) = *x;
+}
+
+la_ooc_read_d(stream, f, path, nb, extra, rest)
+FILE *stream;
+la_ooc_d *f;
+char *path;
+la_matrix_d *rest;
+{
+    la_matrix_d m;
+    double *row;
+    int c, i, j, n, cols, count, cap;
+
+    if ((c = getc(stream)) == 0x93) {
+        /* A NumPy array is mapped, its pages are only read once. */
+        ungetc(c, stream);
+        la_allocate_matrix_d(&m, 0, 0);
+        la_read_matrix_d(stream, &m);
+        if ((n = m.cols - extra) != m.rows || n < 0 ||
+            la_ooc_create_d(f, path, n, nb)) {
+            if (n != m.rows || n < 0)
+                fputs("[la_ooc_read_d] The matrix is not square.\n", stderr);
+            la_free_matrix_d(&m);
+            return -1;
+        }
+        if (rest)
+            la_resize_matrix_d(rest, n, extra);
+        for (i=0; i < n; i++)
+            la_ooc_put_row_d(f, i, 0, &LA_AT(&m, i, 0), m.cols, rest);
+        la_free_matrix_d(&m);
+        return 0;
+    }
+    if (c != EOF)
+        ungetc(c, stream);
+    /* The first row gives the order. */
+    cap = 1 << 16;
+    row = la_malloc(cap, sizeof(double));
+    cols = 0;
+    do {
+        if (cols == cap)
+            row = realloc(row, sizeof(double) * (cap <<= 1));
+        count = la_read_vector_chunk_d(stream, row + cols, cap - cols);
+        cols += count;
+    } while (cols == cap || (!cols && !feof(stream)));
+    if ((n = cols - extra) < 1 || la_ooc_create_d(f, path, n, nb)) {
+        if (n < 1)
+            fputs("[la_ooc_read_d] No square matrix.\n", stderr);
+        free(row);
+        return -1;
+    }
+    if (rest)
+        la_resize_matrix_d(rest, n, extra);
+    la_ooc_put_row_d(f, 0, 0, row, cols, rest);
+    j = cols;
+    /* The next rows go a panel at a time straight to the file. */
+    for (i=1; i < n; i++) {
+        if ((c = getc(stream)) == 'e' || c == EOF)
+            break;
+        ungetc(c, stream);
+        for (j=0; j < cols; j += count) {
+            count = j < n && nb - j%nb < cols - j? nb - j%nb : cols - j;
+            if (!(count = la_read_vector_chunk_d(stream, row, count)))
+                break;
+            la_ooc_put_row_d(f, i, j, row, count, rest);
+        }
+        /* The rest of a full row must be blank, its numbers are counted. */
+        if (j == cols)
+            do
+                j += count = la_read_vector_chunk_d(stream, row, cap);
+            while (count == cap);
+        /* Lines without numbers are skipped. */
+        if (!j)
+            i--;
+        else if (j != cols) {
+            fprintf(stderr, "[la_ooc_read_d] Row %d has %d values, expected %d.\n",
+                    i+1, j, cols);
+            break;
+        }
+    }
+    free(row);
+    if (i < n) {
+        if (j == cols || !j)
+            fprintf(stderr, "[la_ooc_read_d] %d rows, expected %d.\n", i, n);
+        la_free_ooc_d(f);
+        return -1;
+    }
+    return 0;
+}
+
+/* Copy of a panel by a helper thread, so that reading it from the file
+ * overlaps with the work on the previous one. */
+struct la_ooc_fetch {
+    double *dst, *src;
+    size_t count;
+    pthread_t thread;
+    int started;
+};
+
+static void *la_ooc_fetch_thread(p)
+struct la_ooc_fetch *p;
+{
+    memcpy(p->dst, p->src, sizeof(double) * p->count);
+    return NULL;
+}
+
+static void la_ooc_fetch_start(p, dst, src, count)
+struct la_ooc_fetch *p;
+double *dst, *src;
+size_t count;
+{
+    p->dst = dst;
+    p->src = src;
+    p->count = count;
+    if (!(p->started = !pthread_create(&p->thread, NULL, la_ooc_fetch_thread, p)))
+        la_ooc_fetch_thread(p);
+}
+
+static void la_ooc_fetch_wait(p)
+struct la_ooc_fetch *p;
+{
+    if (p->started)
+        pthread_join(p->thread, NULL);
+    p->started = 0;
+}
+
+la_ooc_getrf_d(f, nthreads)
+la_ooc_d *f;
+{
+    struct la_ooc_fetch fetch;
+    double *p, *l[2], *lk;
+    int nb, nt, big, j, k, m, i, info, iinfo;
+    size_t panel;
+
+    nb = f->nb, nt = f->nt;
+    big = nt*nb;
+    panel = (size_t)big * nb;
+    p = la_aligned_alloc(panel, sizeof(double));
+    l[0] = la_aligned_alloc(panel, sizeof(double));
+    l[1] = la_aligned_alloc(panel, sizeof(double));
+    fetch.started = 0;
+    info = 0;
+    for (j=0; j < nt; j++) {
+        if (j+1 < nt)
+            madvise(LA_OOC_PANEL(f, j+1), sizeof(double) * panel, MADV_WILLNEED);
+        memcpy(p, LA_OOC_PANEL(f, j), sizeof(double) * panel);
+        la_laswp_d(nb, p, nb, 0, j*nb, f->ipiv);
+        /* Left-looking: the panels at the left update this one, each read
+         * while the previous one is used, with the rows in the order of all
+         * the interchanges so far. */
+        if (j)
+            la_ooc_fetch_start(&fetch, l[0], LA_OOC_PANEL(f, 0), panel);
+        for (k=0; k < j; k++) {
+            la_ooc_fetch_wait(&fetch);
+            lk = l[k%2];
+            if (k+1 < j)
+                la_ooc_fetch_start(&fetch, l[(k+1)%2], LA_OOC_PANEL(f, k+1), panel);
+            /* The interchanges of the panels after k, not yet in its L. */
+            for (m=k+1; m < j; m++)
+                la_laswp_d(nb, lk, nb, m*nb, (m+1)*nb, f->ipiv);
+            cblas_dtrsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans,
+                        CblasUnit, nb, nb, 1.0, lk + (size_t)k*nb*nb, nb,
+                        p + (size_t)k*nb*nb, nb);
+            la_gemm_parallel_d(0, big - (k+1)*nb, nb, nb, -1.0,
+                               lk + (size_t)(k+1)*nb*nb, nb, p + (size_t)k*nb*nb,
+                               nb, 1.0, p + (size_t)(k+1)*nb*nb, nb, nthreads);
+        }
+        if ((iinfo = la_getrf_d(big - j*nb, nb, p + (size_t)j*nb*nb, nb,
+                                f->ipiv + j*nb)) && !info)
+            info = iinfo + j*nb;
+        for (i=j*nb; i < (j+1)*nb; i++)
+            f->ipiv[i] += j*nb;
+        memcpy(LA_OOC_PANEL(f, j), p, sizeof(double) * panel);
+    }
+    /* Bring the interchanges of the later panels into each L. */
+    for (k=0; k < nt; k++)
+        for (m=k+1; m < nt; m++)
+            la_laswp_d(nb, LA_OOC_PANEL(f, k), nb, m*nb, (m+1)*nb, f->ipiv);
+    free(p), free(l[0]), free(l[1]);
+    return info > f->n? 0 : info;
+}
+
+void la_ooc_getrs_d(f, nrhs, b, ldb)
+la_ooc_d *f;
+double *b;
+{
+    double *x, *a;
+    int nb, nt, big, i, j, k;
+
+    nb = f->nb, nt = f->nt;
+    big = nt*nb;
+    if (!nrhs)
+        return;
+    x = la_malloc((size_t)big * nrhs, sizeof(double));
+    for (i=0; i < big; i++)
+        for (j=0; j < nrhs; j++)
+            x[(size_t)i*nrhs + j] = i < f->n? b[(size_t)i*ldb + j] : 0;
+    la_laswp_d(nrhs, x, nrhs, 0, big, f->ipiv);
+    /* L*y = P*b and U*x = y, a panel at a time. */
+    for (k=0; k < nt; k++) {
+        a = LA_OOC_PANEL(f, k);
+        cblas_dtrsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans,
+                    CblasUnit, nb, nrhs, 1.0, a + (size_t)k*nb*nb, nb,
+                    x + (size_t)k*nb*nrhs, nrhs);
+        if (k+1 < nt)
+            cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                        big - (k+1)*nb, nrhs, nb, -1.0, a + (size_t)(k+1)*nb*nb,
+                        nb, x + (size_t)k*nb*nrhs, nrhs, 1.0,
+                        x + (size_t)(k+1)*nb*nrhs, nrhs);
+    }
+    for (k=nt-1; k >= 0; k--) {
+        a = LA_OOC_PANEL(f, k);
+        cblas_dtrsm(CblasRowMajor, CblasLeft, CblasUpper, CblasNoTrans,
+                    CblasNonUnit, nb, nrhs, 1.0, a + (size_t)k*nb*nb, nb,
+                    x + (size_t)k*nb*nrhs, nrhs);
+        if (k)
+            cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, k*nb, nrhs,
+                        nb, -1.0, a, nb, x + (size_t)k*nb*nrhs, nrhs, 1.0, x,
+                        nrhs);
+    }
+    for (i=0; i < f->n; i++)
+        for (j=0; j < nrhs; j++)
+            b[(size_t)i*ldb + j] = x[(size_t)i*nrhs + j];
+    free(x);
+}
+
+double la_ooc_log_det_d(f, sign)
+la_ooc_d *f;
+int *sign;
+{
+    int k;
+    double log_det, ukk;
+
+    *sign = 1;
+    for (log_det=k=0; k < f->n; k++) {
+        ukk = LA_OOC_AT(f, k, k);
+        if (!ukk) {
+            *sign = 0;
+            return -HUGE_VAL;
+        }
+        if ((ukk < 0) != (f->ipiv[k] != k))
+            *sign = -*sign;
+        log_det += log(fabs(ukk));
+    }
+    return log_det;
+}
@@ -1,9 +1,37 @@
 /*
-    linear_algebra.h - v2.1.0
+    linear_algebra.h - v2.23.0
     Declarations of utility functions to deal with matrices.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
 
     History:
+        v2.23.0 la_syev_jacobi_d()
+        v2.22.0 la_getrf_dag_d(), la_potrf_dag_d(), LA_TILE and nthreads in
+                la_chol_factor_d()
+        v2.21.0 la_ooc_d out-of-core matrices and LU
+        v2.20.0 la_inv_batch_d(), la_batch_d and la_peek()
+        v2.19.0 la_det_batch_d()
+        v2.18.0 la_frobenius_d()
+        v2.17.0 la_vector_sums_d() and la_read_vector_chunk_d()
+        v2.16.0 la_gelqf_d() and la_orglq_d() Householder LQ factorization
+        v2.15.0 la_getrf_s(), la_getf2_s(), la_laswp_s(), la_getrs_s() and
+                la_gesv_refine_d()
+        v2.14.0 la_potrf_d() and la_chol_d sparse Cholesky factorization
+        v2.13.0 la_csr_d sparse matrices, la_read_matrix_market_d(),
+                la_csr_mv_d(), la_cg_d() and la_gmres_d()
+        v2.12.0 la_gemm_parallel_d(), nthreads in la_gemm_batch_d() and
+                la_arg_pin
+        v2.11.0 la_gemm_d(), la_arg_blas, la_parse_blas() and
+                la_gemm_kernel_name()
+        v2.10.0 la_gemm_batch_d()
+        v2.9.0  NumPy .npy binary matrices, la_arg_binary and
+                la_parse_output_format()
+        v2.8.0  la_arg_symbolic
+        v2.7.0  la_strtod()
+        v2.6.0  la_getri_d(), la_parallel() and la_nprocs()
+        v2.5.0  la_read_matrix_rows_*()
+        v2.4.0  la_getrs_d()
+        v2.3.0  la_getrf_d(), la_getf2_d(), la_laswp_d() and la_log_det_d()
+        v2.2.0  la_matrix_s and la_matrix_d heap-allocated matrices
         v2.1.0  la_arg_precision
         v2.0.0  stream args and lda in la_read_matrices_*
         v1.0.0  First version
@@ -22,15 +50,75 @@
 #define LA_H
 
 #include <stdio.h>
+#include <stddef.h>
 
 #include "la_eps.h"
 
 #define LA_SIZE 30
 
+/* Alignment in bytes of the rows of a la_matrix_*, one cache line. */
+#define LA_ALIGN 64
+
+/* Panel width of the blocked factorizations. */
+#define LA_BLOCK 64
+
+/* Tile order of the task-graph factorizations. */
+#define LA_TILE 256
+
+#define LA_AT(M, I, J) ((M)->base[(size_t)(I) * (M)->lda + (J)])
+
 extern la_arg_precision;
 
+/* If zero, la_show_matrix_* do not look for known constants. */
+extern la_arg_symbolic;
+
+/* If not zero, la_show_matrix_* write NumPy .npy arrays. */
+extern la_arg_binary;
+
+/* Set la_arg_binary from "text" or "bin", return -1 for other formats. */
+int la_parse_output_format(char *s);
+
+/* GEMM of la_gemm_d(): the system CBLAS or the built-in one. */
+#define LA_BLAS_SYSTEM 0
+#define LA_BLAS_INTERNAL 1
+extern la_arg_blas;
+
+/* Set la_arg_blas from "system" or "internal", return -1 for other names. */
+int la_parse_blas(char *s);
+
+/* Row-major matrix whose rows start at LA_ALIGN boundaries, lda is the number
+ * of elements between the start of two consecutive rows and capacity the
+ * number of elements allocated. Matrices mapped from a NumPy array have
+ * lda equal to cols and map is the start of the mapping. */
+typedef struct {
+    float *base;
+    int rows, cols, lda;
+    size_t capacity;
+    char *map;
+    size_t map_size;
+} la_matrix_s;
+
+typedef struct {
+    double *base;
+    int rows, cols, lda;
+    size_t capacity;
+    char *map;
+    size_t map_size;
+} la_matrix_d;
+
+/* Like strtod() in the C locale, but faster for numbers with at most 19
+ * significant digits and small exponents. */
+double la_strtod(const char *s, char **end);
+
 /* WARNING: these functions do not handle invalid memory access. */
 
+/* Read up to max numbers of the current line of stream into x and return
+ * how many, fewer than max only at the end of the line, whose newline is
+ * then read. A vector longer than memory is read a chunk at a time. */
+int la_read_vector_chunk_d(FILE *stream, double *x, int max);
+
+/* With la_arg_binary, la_show_matrix_* write one .npy array. */
+
 void la_show_matrix_s(FILE *stream, float *a, int rows, int cols, int lda);
 void la_show_pointer_matrix_s(FILE *stream, float a[][LA_SIZE], int rows, int cols);
 
@@ -45,4 +133,309 @@ void la_read_matrices_d(FILE *stream, double *a, int *rows, int *cols, int lda);
 void la_read_one_pointer_matrix_s(FILE *stream, float a[][LA_SIZE], int *rows, int *cols);
 void la_read_one_pointer_matrix_d(FILE *stream, double a[][LA_SIZE], int *rows, int *cols);
 
+/* Allocation failures print a message and exit. The contents are kept when
+ * the matrix grows, new cells are zeroed. */
+
+void la_allocate_matrix_s(la_matrix_s *m, int rows, int cols);
+void la_resize_matrix_s(la_matrix_s *m, int rows, int cols);
+void la_free_matrix_s(la_matrix_s *m);
+
+void la_allocate_matrix_d(la_matrix_d *m, int rows, int cols);
+void la_resize_matrix_d(la_matrix_d *m, int rows, int cols);
+void la_free_matrix_d(la_matrix_d *m);
+
+/* Read until a line "e" or EOF, growing m as needed; m must be allocated. The
+ * number of columns is the longest row, shorter rows are filled with zeros.
+ * Numbers are separated by any white space and blank lines are skipped.
+ * A matrix that starts with the magic string of NumPy is read whole as a .npy
+ * array of float or double, mapped when possible. */
+
+void la_read_matrix_s(FILE *stream, la_matrix_s *m);
+void la_read_matrix_d(FILE *stream, la_matrix_d *m);
+
+/* Same, but stop after max_rows rows. Return the number of rows read. */
+
+int la_read_matrix_rows_s(FILE *stream, la_matrix_s *m, int max_rows);
+int la_read_matrix_rows_d(FILE *stream, la_matrix_d *m, int max_rows);
+
+/* Skip white space and return the next character of stream, without
+ * reading it. */
+int la_peek(FILE *stream);
+
+/* LU factorization with partial pivoting of the m x n matrix a, in place: L
+ * has unit diagonal and row i was interchanged with row ipiv[i]. Return 0, or
+ * k if U(k-1,k-1) is exactly zero. la_getf2_d() is the unblocked version,
+ * la_getrf_d() works by panels of LA_BLOCK columns with BLAS-3 updates. */
+
+int la_getf2_d(int m, int n, double *a, int lda, int *ipiv);
+int la_getrf_d(int m, int n, double *a, int lda, int *ipiv);
+void la_laswp_d(int n, double *a, int lda, int k1, int k2, int *ipiv);
+
+/* Solve A*X = B with the factors of la_getrf_d(), B is n x nrhs and is
+ * overwritten by X. */
+void la_getrs_d(int n, int nrhs, double *a, int lda, int *ipiv, double *b, int ldb);
+
+/* The same in float. */
+int la_getf2_s(int m, int n, float *a, int lda, int *ipiv);
+int la_getrf_s(int m, int n, float *a, int lda, int *ipiv);
+void la_laswp_s(int n, float *a, int lda, int k1, int k2, int *ipiv);
+void la_getrs_s(int n, int nrhs, float *a, int lda, int *ipiv, float *b, int ldb);
+
+/* Mixed-precision iterative refinement: solve A*X = B with lu, the factors of
+ * la_getrf_s() of A in float, and correct X by the residuals B - A*X
+ * computed in double, until the backward error |B - A*X|/(|A||X| + |B|) of
+ * every column is at most sqrt(n) times DBL_EPSILON, after max_iter
+ * corrections or once a correction does not halve it. berr is set to that
+ * backward error. Return the number of corrections, or -1 if X did not reach
+ * double accuracy. */
+int la_gesv_refine_d(int n, int nrhs, double *a, int lda, float *lu, int ldlu,
+                     int *ipiv, double *b, int ldb, double *x, int ldx,
+                     int max_iter, double *berr);
+
+/* C = alpha*A*op(B) + beta*C in row-major order, A is m x k and op(B) is
+ * k x n, the transpose of B if trans_b. C is not read when beta is zero. By
+ * la_arg_blas, this calls cblas_dgemm() or the built-in GEMM, which packs
+ * cache-sized blocks of A and B for a register-blocked microkernel. */
+void la_gemm_d(int trans_b, int m, int n, int k, double alpha, double *a,
+               int lda, double *b, int ldb, double beta, double *c, int ldc);
+
+/* Add x.y, x.x, y.y and (x-y).(x-y) of n elements to sums[0..3], all in one
+ * pass with SIMD where the processor has it. */
+void la_vector_sums_d(int n, double *x, double *y, double *sums);
+
+/* Frobenius inner product sum(A(i,j)*B(i,j)) = trace(A*B^T) of two m x n
+ * matrices, with compensated summation and the rows split among nthreads
+ * threads for large matrices. */
+double la_frobenius_d(int m, int n, double *a, int lda, double *b, int ldb,
+                      int nthreads);
+
+/* Name of the microkernel of the built-in GEMM for this processor: "avx512",
+ * "avx2" or "generic". */
+char *la_gemm_kernel_name(void);
+
+/* la_gemm_d() by nthreads threads, each one on panels of rows of C, or
+ * columns if C is wider than tall. Small products run in one thread. */
+void la_gemm_parallel_d(int trans_b, int m, int n, int k, double alpha,
+                        double *a, int lda, double *b, int ldb, double beta,
+                        double *c, int ldc, int nthreads);
+
+/* C_p = A_p*B_p for count products of the same shape, A_p is m x k, B_p is
+ * k x n and C_p is m x n; the matrices of each operand are stride elements
+ * apart. Small products are done in a plain loop rather than a BLAS call and
+ * split among nthreads threads, large ones are each split in panels. */
+void la_gemm_batch_d(int count, int m, int n, int k, double *a, int lda,
+                     size_t stride_a, double *b, int ldb, size_t stride_b,
+                     double *c, int ldc, size_t stride_c, int nthreads);
+
+/* Inverse of an n x n matrix from the factors of la_getrf_d(), in place and
+ * with O(n*LA_BLOCK) extra memory. The rows of each block column are split
+ * among nthreads threads. Return 0, or k if U(k-1,k-1) is zero. */
+int la_getri_d(int n, double *a, int lda, int *ipiv, int nthreads);
+
+/* If not zero, la_parallel() pins its threads to consecutive processors. */
+extern la_arg_pin;
+
+/* Call fn(arg, begin, end) for nthreads slices of [0, n) in parallel and wait
+ * for all of them. */
+void la_parallel(int nthreads, int n, void (*fn)(), void *arg);
+
+/* Number of online processors. */
+int la_nprocs(void);
+
+/* Natural logarithm of |det| of the LU factors of an n x n matrix; sign is set
+ * to -1, 0 or 1. */
+double la_log_det_d(int n, double *a, int lda, int *ipiv, int *sign);
+
+/* Determinants of count n x n matrices, matrix p at a + p*stride with its
+ * rows lda elements apart. Up to 4 x 4, closed forms evaluate four matrices
+ * at once, one per SIMD lane; larger ones go by LU. */
+void la_det_batch_d(int count, int n, double *a, int lda, size_t stride,
+                    double *det);
+
+/* Inverses of count n x n matrices laid out as in la_det_batch_d(), the
+ * inverse of matrix p at inv + p*n*n with its rows n elements apart. Up to
+ * 4 x 4 they are adjugates over the determinant, four matrices at once;
+ * larger ones go by LU. singular[p] is set to 1 if matrix p is singular,
+ * its inverse then being NaN, else to 0. */
+void la_inv_batch_d(int count, int n, double *a, int lda, size_t stride,
+                    double *inv, int *singular);
+
+/* A stream of square matrices read by la_read_batch_d() for
+ * la_det_batch_d() and la_inv_batch_d(): the batch has count matrices of
+ * order n, matrix p at base + p*stride with its rows lda elements apart. */
+typedef struct {
+    double *base;
+    int count, n, lda;
+    size_t stride;
+    /* Of the reader. */
+    la_matrix_d m;
+    double *stack;
+    size_t capacity;
+    int max, pending, done;
+} la_batch_d;
+
+/* A reader of batches of at most max matrices. */
+void la_allocate_batch_d(la_batch_d *b, int max);
+
+/* Read the next batch of b: the following matrices of the same order in
+ * stream, up to max, separated by lines "e"; or the next whole NumPy array
+ * of n x n matrices stacked by rows, in place, each array of the stream
+ * being a batch. Return count, 0 at the end of the stream or -1 if a matrix
+ * is not square. */
+int la_read_batch_d(FILE *stream, la_batch_d *b);
+void la_free_batch_d(la_batch_d *b);
+
+/* Out-of-core n x n matrix in a memory-mapped scratch file, stored by panels
+ * of nb columns, each one a row-major nt*nb x nb matrix; the order is padded
+ * to nt*nb with ones on the diagonal. ipiv has the interchanges of
+ * la_ooc_getrf_d(). */
+typedef struct {
+    int n, nb, nt;
+    double *map;
+    size_t size;
+    int *ipiv;
+} la_ooc_d;
+
+#define LA_OOC_AT(F, I, J) ((F)->map[((size_t)((J) / (F)->nb) * (F)->nt*(F)->nb \
+                                      + (I)) * (F)->nb + (J) % (F)->nb])
+
+/* Create the scratch file at path, removed at once from its directory, for
+ * an n x n matrix of zeros with panels of nb columns. Return 0, or -1 if the
+ * file could not be made. */
+int la_ooc_create_d(la_ooc_d *f, char *path, int n, int nb);
+void la_free_ooc_d(la_ooc_d *f);
+
+/* Read a square matrix followed by extra columns into a new out-of-core f,
+ * the extra columns into rest, which may be NULL without them. Text rows go
+ * to the file as they are read, never all in memory. Return 0, or -1 on
+ * error. */
+int la_ooc_read_d(FILE *stream, la_ooc_d *f, char *path, int nb, int extra,
+                  la_matrix_d *rest);
+
+/* LU factorization with partial pivoting of f, in place in its file, as
+ * la_getrf_d(). Left-looking: each panel in turn is updated by the panels
+ * at its left, read by a helper thread one ahead of the GEMMs, so that only
+ * three panels are ever in memory. */
+int la_ooc_getrf_d(la_ooc_d *f, int nthreads);
+
+/* Solve A*X = B with the factors of la_ooc_getrf_d(), B is n x nrhs. */
+void la_ooc_getrs_d(la_ooc_d *f, int nrhs, double *b, int ldb);
+
+double la_ooc_log_det_d(la_ooc_d *f, int *sign);
+
+/* Sparse matrix in compressed sparse rows: the columns and values of row i
+ * are col[k] and val[k] for k in [row_ptr[i], row_ptr[i+1]), in increasing
+ * order of column. */
+typedef struct {
+    int rows, cols;
+    size_t nnz;
+    size_t *row_ptr;
+    int *col;
+    double *val;
+} la_csr_d;
+
+void la_free_csr_d(la_csr_d *m);
+
+/* Read a Matrix Market coordinate matrix of real, integer or pattern entries,
+ * general, symmetric or skew-symmetric, and leave the stream after its last
+ * entry. Duplicated entries are added. Return 0, or -1 if the input is not
+ * such a matrix. */
+int la_read_matrix_market_d(FILE *stream, la_csr_d *m);
+
+/* y = A*x, the rows split among nthreads threads for large matrices. */
+void la_csr_mv_d(la_csr_d *a, double *x, double *y, int nthreads);
+
+/* Solve A*x = b from the guess in x, by conjugate gradients for symmetric
+ * positive definite A or by GMRES restarted every restart iterations for any
+ * A, both with a Jacobi preconditioner. Stop when ||b - A*x|| <= tol*||b|| or
+ * after max_iter iterations. Return the iterations done and set residual to
+ * ||b - A*x|| / ||b||. */
+int la_cg_d(la_csr_d *a, double *b, double *x, double tol, int max_iter,
+            int nthreads, double *residual);
+int la_gmres_d(la_csr_d *a, double *b, double *x, int restart, double tol,
+               int max_iter, int nthreads, double *residual);
+
+/* Cholesky factorization A = L*L^T of the lower triangle of a symmetric
+ * positive definite n x n matrix, in place. Return 0, or j if the j-th pivot
+ * is not positive. */
+int la_potrf_d(int n, double *a, int lda);
+
+/* la_getrf_d() as a graph of tasks on nb x nb tiles, LA_TILE if nb < 1: the
+ * factorization of each column of tiles, the interchanges and triangular
+ * solve of each tile at its right, and the GEMM update of each tile below.
+ * nthreads threads run the tasks as they become ready, stealing from each
+ * other when idle, so that the next panel is factored while the updates of
+ * the previous one go on. Same pivots and result as la_getrf_d(). */
+int la_getrf_dag_d(int m, int n, double *a, int lda, int *ipiv, int nb,
+                   int nthreads);
+
+/* Cholesky factorization of the first n columns of the m x m lower triangle
+ * of a, with the Schur complement of the remaining m-n rows left in their
+ * place, as a graph of potrf, trsm, syrk and gemm tasks on nb x nb tiles run
+ * by nthreads threads as in la_getrf_dag_d(). Return 0, or j if the j-th
+ * pivot is not positive. */
+int la_potrf_dag_d(int m, int n, double *a, int lda, int nb, int nthreads);
+
+/* Householder LQ factorization A = L*Q of the m x n matrix a, in place: L is
+ * at and below the diagonal, and row i of a holds, at the right of the
+ * diagonal, the reflector H(i) = I - tau[i]*v*v^T with v(i) = 1, so that
+ * Q = H(k-1)*...*H(0) with k = min(m, n). Panels of LA_BLOCK rows are
+ * reduced one row at a time and update the rest of a with GEMMs by nthreads
+ * threads. */
+void la_gelqf_d(int m, int n, double *a, int lda, double *tau, int nthreads);
+
+/* The m x n Q of la_gelqf_d(), m <= n, with orthonormal rows, in place of
+ * its factors. */
+void la_orglq_d(int m, int n, double *a, int lda, double *tau, int nthreads);
+
+/* Eigenvalues w, in decreasing order, and eigenvectors, in the rows of v, of
+ * the symmetric n x n matrix a by cyclic Jacobi rotations, for the small
+ * matrices of the projection methods. a is overwritten. Return 0, or -1 if
+ * it did not converge. */
+int la_syev_jacobi_d(int n, double *a, int lda, double *w, double *v,
+                     int ldv);
+
+/* Sparse Cholesky factorization P*A*P^T = L*L^T. perm is a nested dissection
+ * ordering, row i of L is row perm[i] of A. Column j of L belongs to the
+ * supernode s with super[s] <= j < super[s+1], whose columns share the rows
+ * rows[row_ptr[s] .. row_ptr[s+1]); the first ones are the columns
+ * themselves. Its values are a dense row-major panel at val + val_ptr[s],
+ * with one row per row and one column per column of the supernode. */
+typedef struct {
+    int n, nsuper;
+    int *perm;
+    int *super;
+    int *nchild;
+    size_t *row_ptr;
+    int *rows;
+    size_t *val_ptr;
+    double *val;
+    int maxfront;
+    /* Lower triangle of P*A*P^T by columns and where its values are in A. */
+    size_t *cp;
+    int *ci;
+    size_t *amap;
+    /* Pattern of A analyzed. */
+    size_t nnz;
+    size_t *a_row_ptr;
+    int *a_col;
+} la_chol_d;
+
+/* Ordering and symbolic factorization of a symmetric matrix stored with
+ * both triangles. Return 0, or -1 if a is not square. */
+int la_chol_analyze_d(la_csr_d *a, la_chol_d *f);
+
+/* If a has the pattern analyzed in f, which can then be factored again. */
+int la_chol_same_pattern_d(la_chol_d *f, la_csr_d *a);
+
+/* Numeric factorization of a with the analysis in f, by the multifrontal
+ * method with dense BLAS-3 on the supernodes, large ones by la_potrf_dag_d()
+ * with nthreads threads. Return 0, or j if the j-th pivot is not positive. */
+int la_chol_factor_d(la_chol_d *f, la_csr_d *a, int nthreads);
+
+/* Solve A*x = b with the factors, b and x may be the same. */
+void la_chol_solve_d(la_chol_d *f, double *b, double *x);
+
+void la_free_chol_d(la_chol_d *f);
+
 #endif
@@ -1,9 +1,14 @@
 /*
-    linear_eq_tester - v2.0.0
+    linear_eq_tester - v2.4.0
     Tests if a solution to a linear system is correct.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
     
     History:
+        v2.4.0  Solutions argument checking many solutions by their residuals
+                and tolerance argument
+        v2.3.0  Output format argument
+        v2.2.0  No symbolic argument
+        v2.1.0  Heap-allocated matrix of any size
         v2.0.0  Printing precision argument and remove last space in output
         v1.0.1  stream arg in la_read_one_pointer_matrix_d() and
                 la_show_pointer_matrix_d()
@@ -30,28 +35,124 @@
 #include "linear_algebra.h"
 
 
-double matrix[LA_SIZE][LA_SIZE];
-double values[LA_SIZE];
+/* Candidate solutions checked at a time by check_solutions(). */
+#define SOLUTION_BATCH 4096
+
+/* Check each line of stream, a candidate solution of the system [A | b] in
+ * matrix, by the residuals R = X*A^T - b of a batch of lines at a time in one
+ * GEMM. Print for each one the max-norm of its residual, its backward error
+ * |r|/(|A||x| + |b|) and pass or fail by tol. Return the number of
+ * failures, or -1 on error. */
+check_solutions(stream, matrix, tol)
+FILE *stream;
+la_matrix_d *matrix;
+double tol;
+{
+    la_matrix_d x, r, out;
+    int m, n, i, j, failed, total;
+    double anorm, bnorm, rnorm, xnorm, row, berr;
+
+    m = matrix->rows;
+    n = matrix->cols - 1;
+    for (anorm=bnorm=i=0; i < m; i++) {
+        for (row=j=0; j < n; j++)
+            row += fabs(LA_AT(matrix, i, j));
+        anorm = fmax(anorm, row);
+        bnorm = fmax(bnorm, fabs(LA_AT(matrix, i, n)));
+    }
+    la_allocate_matrix_d(&x, 0, 0);
+    la_allocate_matrix_d(&r, SOLUTION_BATCH, m);
+    la_allocate_matrix_d(&out, SOLUTION_BATCH, 3);
+    failed = total = 0;
+    while (la_read_matrix_rows_d(stream, &x, SOLUTION_BATCH)) {
+        if (x.cols != n) {
+            fprintf(stderr, "linear_eq_tester: solution with %d values, expected %d.\n",
+                    x.cols, n);
+            failed = -1;
+            break;
+        }
+        /* Binary solutions come all at once. */
+        if (x.rows > r.rows) {
+            la_resize_matrix_d(&r, x.rows, m);
+            la_resize_matrix_d(&out, x.rows, 3);
+        }
+        la_gemm_d(1, x.rows, m, n, 1.0, x.base, x.lda, matrix->base,
+                  matrix->lda, 0.0, r.base, r.lda);
+        for (i=0; i < x.rows; i++) {
+            /* Not fmax(), which drops a NaN: a NaN solution must fail. */
+            for (rnorm=j=0; j < m; j++)
+                if (!(fabs(LA_AT(&r, i, j) - LA_AT(matrix, j, n)) <= rnorm))
+                    rnorm = fabs(LA_AT(&r, i, j) - LA_AT(matrix, j, n));
+            for (xnorm=j=0; j < n; j++)
+                if (!(fabs(LA_AT(&x, i, j)) <= xnorm))
+                    xnorm = fabs(LA_AT(&x, i, j));
+            berr = rnorm? rnorm / (anorm*xnorm + bnorm) : 0;
+            LA_AT(&out, i, 0) = rnorm;
+            LA_AT(&out, i, 1) = berr;
+            LA_AT(&out, i, 2) = berr <= tol;
+            failed += !(berr <= tol);
+            if (!la_arg_binary)
+                printf("%.*e %.*e %s\n", la_arg_precision, rnorm,
+                       la_arg_precision, berr, berr <= tol? "pass" : "fail");
+        }
+        /* One row per solution: residual, backward error and 1 if passed. */
+        if (la_arg_binary)
+            la_show_matrix_d(stdout, out.base, x.rows, 3, out.lda);
+        total += x.rows;
+        if (x.rows < SOLUTION_BATCH)
+            break;
+    }
+    if (failed >= 0 && !la_arg_binary)
+        printf("%d of %d solutions passed.\n", total - failed, total);
+    la_free_matrix_d(&x);
+    la_free_matrix_d(&r);
+    la_free_matrix_d(&out);
+    return failed;
+}
 
 main(argc, argv)
 char *argv[];
 {
+    la_matrix_d matrix;
+    double *values, *sums;
     int rows, cols;
     int i,j,k;
     double sum;
 
     struct option long_opts[] = {
         {"help", no_argument, NULL, 'h'},
+        {"no-symbolic", no_argument, NULL, 'n'},
+        {"output-format", required_argument, NULL, 'o'},
         {"precision", required_argument, NULL, 'p'},
+        {"solutions", required_argument, NULL, 's'},
+        {"tolerance", required_argument, NULL, 'e'},
         { 0 },
     };
     int opt;
+    char *arg_solutions = NULL;
+    double arg_tolerance = 1e-10;
+    FILE *solutions;
 
-    for (; (opt = getopt_long(argc, argv, "p:", long_opts, NULL)) != -1;)
+    for (; (opt = getopt_long(argc, argv, "e:no:p:s:", long_opts, NULL)) != -1;)
         switch (opt) {
+        case 'e':
+            arg_tolerance = atof(optarg);
+            break;
+        case 'n':
+            la_arg_symbolic = 0;
+            break;
+        case 'o':
+            if (la_parse_output_format(optarg)) {
+                fprintf(stderr, "linear_eq_tester: invalid output format '%s'.\n", optarg);
+                return 2;
+            }
+            break;
         case 'p':
             la_arg_precision = atoi(optarg);
             break;
+        case 's':
+            arg_solutions = optarg;
+            break;
         case '?':
             fputs("Try 'linear_eq_tester --help' for more information.\n", stderr);
             return 2;
@@ -61,22 +162,68 @@ char *argv[];
                   "The system of equations is read from standard input in a matrix. The program\n"
                   "will ask for the solution in the same order that the coefficients appear in the\n"
                   "system\n\n"
-                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n",
+                  "  -e, --tolerance=TOL\n"
+                  "                     largest backward error of a passing solution, default is\n"
+                  "                     1e-10\n"
+                  "  -n, --no-symbolic  print numbers without looking for known constants\n"
+                  "  -o, --output-format=FORMAT\n"
+                  "                     write matrices as text or bin (NumPy .npy), default is text\n"
+                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n"
+                  "  -s, --solutions=FILE\n"
+                  "                     check every line of FILE, or of the standard input after\n"
+                  "                     the system if FILE is -, as a solution\n\n"
+                  "With --solutions, each solution gets a line with the max-norm of its residual\n"
+                  "A*x - b, its backward error |A*x - b|/(|A||x| + |b|) and pass or fail, and the\n"
+                  "exit status is 1 if any failed.\n",
                   stdout);
             return 0;
         }
 
-    la_read_one_pointer_matrix_d(stdin, matrix, &rows, &cols);
-    puts("Linear System:");
-    la_show_pointer_matrix_d(stdout, matrix, rows, cols);
+    la_allocate_matrix_d(&matrix, 0, 0);
+    la_read_matrix_d(stdin, &matrix);
+    rows = matrix.rows;
+    cols = matrix.cols;
+    if (arg_solutions) {
+        if (cols < 1) {
+            fputs("linear_eq_tester: no system.\n", stderr);
+            return 1;
+        }
+        if (!strcmp(arg_solutions, "-"))
+            solutions = stdin;
+        else if (!(solutions = fopen(arg_solutions, "r"))) {
+            perror(arg_solutions);
+            return 1;
+        }
+        i = check_solutions(solutions, &matrix, arg_tolerance);
+        if (solutions != stdin)
+            fclose(solutions);
+        la_free_matrix_d(&matrix);
+        return i? 1 : 0;
+    }
+    values = malloc(sizeof(double) * cols);
+    if (!la_arg_binary) {
+        puts("Linear System:");
+        la_show_matrix_d(stdout, matrix.base, rows, cols, matrix.lda);
+    }
     for (i=0; i < cols-1; i++) {
-        printf("Variable %02d: ", i+1);
+        if (!la_arg_binary)
+            printf("Variable %02d: ", i+1);
         scanf("%lf", &values[i]);
     }
+    sums = malloc(sizeof(double) * (rows? rows : 1));
     for (k=0; k < rows; k++) {
         for (sum=j=0; j < cols-1; j++)
-            sum += matrix[k][j]*values[j];
+            sum += LA_AT(&matrix, k, j)*values[j];
+        sums[k] = sum;
+        if (la_arg_binary)
+            continue;
         printf("%.*lf ", la_arg_precision, sum);
-        puts(fabs(fabs(sum)-fabs(matrix[k][cols-1])) < LA_EPS? "Equal" : "Not equal");
+        puts(fabs(fabs(sum)-fabs(LA_AT(&matrix, k, cols-1))) < LA_EPS? "Equal" : "Not equal");
     }
+    /* The left sides as a column. */
+    if (la_arg_binary)
+        la_show_matrix_d(stdout, sums, rows, 1, 1);
+    free(sums);
+    free(values);
+    la_free_matrix_d(&matrix);
 }
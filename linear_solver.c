@@ -1,9 +1,23 @@
 /*
-    linear_solver - v2.0.0
+    linear_solver - v2.11.0
     Solves a linear system of equations using Gauss-Jordan elimination.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
     
     History:
+        v2.11.0 Least-squares method by streaming TSQR
+        v2.10.0 Task-graph tiled LU and Cholesky with threads
+        v2.9.0  Out-of-core LU with scratch and tile arguments
+        v2.8.0  Mixed method, LU in float with iterative refinement in double
+        v2.7.0  Sparse Cholesky method, reusing the analysis for systems of the
+                same pattern in a stream
+        v2.6.0  Matrix Market sparse input and method argument with conjugate
+                gradients and GMRES
+        v2.5.0  Output format argument
+        v2.4.0  No symbolic argument
+        v2.3.0  Many right sides in quiet mode, as columns or lines after "e"
+        v2.2.0  Quiet mode solving by blocked LU factorization with partial
+                pivoting
+        v2.1.0  Heap-allocated matrix of any size
         v2.0.0  Printing precision argument and remove last space in output
         v1.0.1  stream arg in la_read_one_pointer_matrix_d() and
                 la_show_pointer_matrix_d()
@@ -23,30 +37,520 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <math.h>
+#include <float.h>
+
 #include <getopt.h>
 
+#include "cblas.h"
+
 #include "linear_algebra.h"
 
 
+/* Number of right sides of the stream solved at once. */
+#define RHS_BATCH 256
+
+/* Most corrections of the mixed-precision refinement before falling back to
+ * LU in double, which comes sooner when the backward error stalls. */
+#define MAX_REFINE 30
+
+/* LU factors of lu_solve(). With mixed, the factors are in float and the
+ * coefficients are kept in double for the refinement, which reports its
+ * worst case in iterations and berr. */
+struct factors {
+    la_matrix_d *a;
+    la_matrix_s lu;
+    int *ipiv, mixed, iterations;
+    double berr;
+    /* Of the LU in double. */
+    int tile, nthreads;
+};
+
+/* Overwrite the n x nrhs right sides b by the solutions. Fall back to LU in
+ * double if the refinement does not reach double accuracy. */
+solve(f, nrhs, b, ldb)
+struct factors *f;
+double *b;
+{
+    int n, i, j, it;
+    double *x, berr;
+
+    n = f->a->rows;
+    if (f->mixed) {
+        x = malloc(sizeof(double) * ((size_t)n * nrhs + 1));
+        it = la_gesv_refine_d(n, nrhs, f->a->base, f->a->lda, f->lu.base,
+                              f->lu.lda, f->ipiv, b, ldb, x, nrhs, MAX_REFINE,
+                              &berr);
+        if (it >= 0) {
+            for (i=0; i < n; i++)
+                for (j=0; j < nrhs; j++)
+                    b[(size_t)i*ldb + j] = x[(size_t)i*nrhs + j];
+            if (it > f->iterations)
+                f->iterations = it;
+            if (berr > f->berr)
+                f->berr = berr;
+            free(x);
+            return 0;
+        }
+        free(x);
+        fprintf(stderr, "linear_solver: float LU refined to backward error %g only, factoring in double.\n",
+                berr);
+        f->mixed = 0;
+        if (la_getrf_dag_d(n, n, f->a->base, f->a->lda, f->ipiv, f->tile,
+                           f->nthreads)) {
+            fputs("linear_solver: the system is singular.\n", stderr);
+            return 1;
+        }
+    }
+    la_getrs_d(n, nrhs, f->a->base, f->a->lda, f->ipiv, b, ldb);
+    return 0;
+}
+
+/* Factor the coefficients once and print only the solutions: first for the
+ * columns at the right of the coefficients, then for each line read after
+ * them, a batch of RHS_BATCH lines at a time. With mixed, factor in float
+ * and refine the solutions in double. */
+lu_solve(matrix, mixed, tile, nthreads)
+la_matrix_d *matrix;
+{
+    struct factors f;
+    la_matrix_d batch, b;
+    int n, nrhs, i, j, ret;
+
+    n = matrix->rows;
+    if (matrix->cols < n) {
+        fputs("linear_solver: quiet mode needs a square system.\n", stderr);
+        return 1;
+    }
+    f.a = matrix;
+    f.ipiv = malloc(sizeof(int) * (n? n : 1));
+    f.mixed = mixed;
+    f.tile = tile;
+    f.nthreads = nthreads;
+    f.iterations = 0;
+    f.berr = 0;
+    /* The float factors are only needed by the refinement. */
+    la_allocate_matrix_s(&f.lu, mixed? n : 0, mixed? n : 0);
+    if (mixed) {
+        for (i=0; i < n; i++)
+            for (j=0; j < n; j++)
+                LA_AT(&f.lu, i, j) = LA_AT(matrix, i, j);
+        if (la_getrf_s(n, n, f.lu.base, f.lu.lda, f.ipiv)) {
+            fputs("linear_solver: singular in float, factoring in double.\n", stderr);
+            f.mixed = 0;
+        }
+    }
+    if (!f.mixed && la_getrf_dag_d(n, n, matrix->base, matrix->lda, f.ipiv,
+                                   tile, nthreads)) {
+        fputs("linear_solver: the system is singular.\n", stderr);
+        la_free_matrix_s(&f.lu);
+        free(f.ipiv);
+        return 1;
+    }
+    ret = 0;
+    if ((nrhs = matrix->cols - n)) {
+        if ((ret = solve(&f, nrhs, &LA_AT(matrix, 0, n), matrix->lda)))
+            goto out;
+        la_show_matrix_d(stdout, &LA_AT(matrix, 0, n), n, nrhs, matrix->lda);
+    }
+    la_allocate_matrix_d(&batch, 0, 0);
+    la_allocate_matrix_d(&b, n, RHS_BATCH);
+    while (la_read_matrix_rows_d(stdin, &batch, RHS_BATCH)) {
+        if (batch.cols != n) {
+            fprintf(stderr, "linear_solver: right side with %d values, expected %d.\n",
+                    batch.cols, n);
+            ret = 1;
+            break;
+        }
+        /* Binary right sides come all at once. */
+        if (batch.rows > b.cols)
+            la_resize_matrix_d(&b, n, batch.rows);
+        /* The right sides are read as rows, la_getrs_d() wants columns. */
+        for (i=0; i < batch.rows; i++)
+            for (j=0; j < n; j++)
+                LA_AT(&b, j, i) = LA_AT(&batch, i, j);
+        if ((ret = solve(&f, batch.rows, b.base, b.lda)))
+            break;
+        for (i=0; i < batch.rows; i++)
+            for (j=0; j < n; j++)
+                LA_AT(&batch, i, j) = LA_AT(&b, j, i);
+        la_show_matrix_d(stdout, batch.base, batch.rows, n, batch.lda);
+        if (batch.rows < RHS_BATCH)
+            break;
+    }
+    la_free_matrix_d(&batch);
+    la_free_matrix_d(&b);
+out:
+    if (mixed && f.mixed && !ret)
+        fprintf(stderr, "linear_solver: float LU, %d refinement iterations, backward error %g.\n",
+                f.iterations, f.berr);
+    la_free_matrix_s(&f.lu);
+    free(f.ipiv);
+    return ret;
+}
+
+/* Methods of sparse_solve(). */
+#define METHOD_CG 0
+#define METHOD_GMRES 1
+#define METHOD_CHOLESKY 2
+
+/* Solve by conjugate gradients, GMRES or sparse Cholesky. The system is a
+ * Matrix Market matrix followed by its right side, or the dense matrix
+ * [A | b]. Without a right side, b is read from rhs_file or is all ones. The
+ * analysis of the last Cholesky factorization is kept for the next system
+ * with the same pattern. */
+sparse_solve(matrix, method, rhs_file, tol, max_iter, restart, nthreads)
+la_matrix_d *matrix;
+char *rhs_file;
+double tol;
+{
+    static la_chol_d chol;
+    static int analyzed = 0;
+    la_csr_d a;
+    la_matrix_d rhs;
+    FILE *fp;
+    double *b, *x, residual;
+    int n, i, j, it, ret;
+    size_t k;
+
+    la_allocate_matrix_d(&rhs, 0, 0);
+    if (!matrix) {
+        if (la_read_matrix_market_d(stdin, &a)) {
+            fputs("linear_solver: invalid Matrix Market coordinate matrix.\n", stderr);
+            return 1;
+        }
+        if (la_peek(stdin) != '%')
+            la_read_matrix_d(stdin, &rhs);
+    } else {
+        /* Non-zeros of the coefficients, the last column is the right side. */
+        a.rows = matrix->rows;
+        a.cols = matrix->cols - 1;
+        a.row_ptr = malloc(sizeof(size_t) * (a.rows+1));
+        for (k=i=0; i < a.rows; i++)
+            for (j=0; j < a.cols; j++)
+                k += LA_AT(matrix, i, j) != 0;
+        a.col = malloc(sizeof(int) * (k? k : 1));
+        a.val = malloc(sizeof(double) * (k? k : 1));
+        la_resize_matrix_d(&rhs, a.rows, 1);
+        for (k=i=0; i < a.rows; i++) {
+            a.row_ptr[i] = k;
+            for (j=0; j < a.cols; j++)
+                if (LA_AT(matrix, i, j)) {
+                    a.col[k] = j;
+                    a.val[k++] = LA_AT(matrix, i, j);
+                }
+            LA_AT(&rhs, i, 0) = LA_AT(matrix, i, a.cols);
+        }
+        a.row_ptr[a.rows] = a.nnz = k;
+    }
+    n = a.rows;
+    if (a.cols != n) {
+        fputs("linear_solver: the coefficients are not square.\n", stderr);
+        la_free_csr_d(&a);
+        la_free_matrix_d(&rhs);
+        return 1;
+    }
+    if (!rhs.rows && rhs_file) {
+        if (!(fp = fopen(rhs_file, "r"))) {
+            perror("linear_solver");
+            la_free_csr_d(&a);
+            la_free_matrix_d(&rhs);
+            return 1;
+        }
+        la_read_matrix_d(fp, &rhs);
+        fclose(fp);
+    }
+    b = malloc(sizeof(double) * (n? n : 1));
+    x = calloc(n? n : 1, sizeof(double));
+    /* The right side may be a row or a column. */
+    if (!rhs.rows)
+        for (i=0; i < n; i++)
+            b[i] = 1;
+    else if ((size_t)rhs.rows * rhs.cols == n)
+        for (i=0; i < n; i++)
+            b[i] = rhs.cols == 1? LA_AT(&rhs, i, 0) : LA_AT(&rhs, 0, i);
+    else {
+        fprintf(stderr, "linear_solver: right side with %d values, expected %d.\n",
+                rhs.rows * rhs.cols, n);
+        free(b), free(x);
+        la_free_csr_d(&a);
+        la_free_matrix_d(&rhs);
+        return 1;
+    }
+    ret = 0;
+    if (method == METHOD_CHOLESKY) {
+        if (analyzed && !la_chol_same_pattern_d(&chol, &a)) {
+            la_free_chol_d(&chol);
+            analyzed = 0;
+        }
+        if (!analyzed) {
+            la_chol_analyze_d(&a, &chol);
+            analyzed = 1;
+        }
+        if ((i = la_chol_factor_d(&chol, &a, nthreads))) {
+            fprintf(stderr, "linear_solver: the matrix is not positive definite at pivot %d.\n",
+                    i);
+            ret = 1;
+        } else
+            la_chol_solve_d(&chol, b, x);
+    } else {
+        if (method == METHOD_CG)
+            it = la_cg_d(&a, b, x, tol, max_iter, nthreads, &residual);
+        else
+            it = la_gmres_d(&a, b, x, restart, tol, max_iter, nthreads, &residual);
+        if (!(residual <= tol)) {
+            fprintf(stderr, "linear_solver: %s stopped after %d iterations with relative residual %g.\n",
+                    method == METHOD_CG? "cg" : "gmres", it, residual);
+            ret = 1;
+        }
+    }
+    if (!ret || method != METHOD_CHOLESKY)
+        la_show_matrix_d(stdout, x, n, 1, 1);
+    free(b), free(x);
+    la_free_csr_d(&a);
+    la_free_matrix_d(&rhs);
+    return ret;
+}
+
+/* Panel width of the out-of-core LU, unless set by --tile. In memory, the
+ * tiles are LA_TILE. */
+#define OOC_TILE 1024
+
+/* Solve [A | b] by LU out of core, in the scratch file. */
+ooc_solve(scratch, tile, nthreads)
+char *scratch;
+{
+    la_ooc_d f;
+    la_matrix_d b;
+    int ret;
+
+    la_allocate_matrix_d(&b, 0, 0);
+    if (la_ooc_read_d(stdin, &f, scratch, tile? tile : OOC_TILE, 1, &b)) {
+        la_free_matrix_d(&b);
+        return 1;
+    }
+    if ((ret = la_ooc_getrf_d(&f, nthreads)))
+        fputs("linear_solver: the system is singular.\n", stderr);
+    else {
+        la_ooc_getrs_d(&f, 1, b.base, b.lda);
+        la_show_matrix_d(stdout, b.base, f.n, 1, b.lda);
+    }
+    la_free_ooc_d(&f);
+    la_free_matrix_d(&b);
+    return ret? 1 : 0;
+}
+
+/* Rows of [A | b] folded at once into the triangular factor of a thread in
+ * least squares, and rows read by thread before folding. */
+#define LSQ_CHUNK 1024
+
+/* Running factor of a thread of lsq_solve(): L = R^T of the QR factorization
+ * of the rows of [A | b] folded so far is in the first c columns of w, and
+ * the next rows are put at its right by columns. */
+struct tsqr {
+    double *w, *tau;
+    int c, ldw;
+};
+
+/* Fold r rows of x into t: the LQ factorization of [L | X^T] leaves the new
+ * L in place of the old. With transposed, x holds X^T, as another L. */
+static void fold(t, x, ldx, r, transposed)
+struct tsqr *t;
+double *x;
+{
+    int i, j, c;
+
+    c = t->c;
+    for (i=0; i < c; i++)
+        for (j=0; j < r; j++)
+            t->w[(size_t)i*t->ldw + c+j] = transposed? x[(size_t)i*ldx + j] :
+                                                       x[(size_t)j*ldx + i];
+    la_gelqf_d(c, c+r, t->w, t->ldw, t->tau, 1);
+    /* The reflectors at the right of the diagonal are not needed. */
+    for (i=0; i < c; i++)
+        memset(t->w + (size_t)i*t->ldw + i+1, 0, sizeof(double) * (c-i-1));
+}
+
+struct lsq_batch {
+    la_matrix_d *rows;
+    struct tsqr *t;
+    int nthreads;
+};
+
+/* Thread begin folds its share of the rows of the batch. */
+static void fold_rows(p, begin, end)
+struct lsq_batch *p;
+{
+    int i, first, last, r;
+
+    first = (long)p->rows->rows * begin / p->nthreads;
+    last = (long)p->rows->rows * (begin+1) / p->nthreads;
+    for (i=first; i < last; i += r) {
+        r = last - i < LSQ_CHUNK? last - i : LSQ_CHUNK;
+        fold(p->t + begin, &LA_AT(p->rows, i, 0), p->rows->lda, r, 0);
+    }
+}
+
+/* Least squares solution of the overdetermined [A | b], read in batches of
+ * rows and folded by nthreads threads into their own R factors, which are
+ * merged at the end (TSQR): only O(cols^2) per thread stays in memory. */
+lsq_solve(nthreads)
+{
+    struct lsq_batch p;
+    struct tsqr *t;
+    la_matrix_d batch;
+    double *l, *x, max;
+    long equations;
+    int n, c, i, ret;
+
+    if (nthreads < 1)
+        nthreads = 1;
+    la_allocate_matrix_d(&batch, 0, 0);
+    t = NULL;
+    c = 0;
+    equations = 0;
+    ret = 0;
+    p.rows = &batch;
+    p.nthreads = nthreads;
+    while (la_read_matrix_rows_d(stdin, &batch, nthreads * LSQ_CHUNK)) {
+        if (!t) {
+            c = batch.cols;
+            t = p.t = malloc(sizeof(struct tsqr) * nthreads);
+            for (i=0; i < nthreads; i++) {
+                t[i].c = c;
+                t[i].ldw = c + (c > LSQ_CHUNK? c : LSQ_CHUNK);
+                t[i].w = calloc((size_t)c * t[i].ldw, sizeof(double));
+                t[i].tau = malloc(sizeof(double) * c);
+            }
+        } else if (batch.cols != c) {
+            fprintf(stderr, "linear_solver: equation with %d values, expected %d.\n",
+                    batch.cols, c);
+            ret = 1;
+            break;
+        }
+        equations += batch.rows;
+        la_parallel(nthreads, nthreads, fold_rows, &p);
+        if (batch.rows < nthreads * LSQ_CHUNK)
+            break;
+    }
+    la_free_matrix_d(&batch);
+    if (!t) {
+        fputs("linear_solver: no equations.\n", stderr);
+        return 1;
+    }
+    for (i=1; i < nthreads; i++)
+        fold(t, t[i].w, t[i].ldw, c, 1);
+    /* R*x = Q^T*b, with Q^T*b in the last row of L and the norm of the
+     * residual at its end. */
+    n = c-1;
+    l = t->w;
+    for (max=i=0; i < n; i++)
+        max = fmax(max, fabs(l[(size_t)i*t->ldw + i]));
+    for (i=0; !ret && i < n; i++)
+        if (!(fabs(l[(size_t)i*t->ldw + i]) > c * DBL_EPSILON * max)) {
+            fputs("linear_solver: the coefficients are rank deficient.\n", stderr);
+            ret = 1;
+        }
+    if (!ret) {
+        x = malloc(sizeof(double) * (n? n : 1));
+        for (i=0; i < n; i++)
+            x[i] = l[(size_t)n*t->ldw + i];
+        cblas_dtrsv(CblasRowMajor, CblasLower, CblasTrans, CblasNonUnit, n, l,
+                    t->ldw, x, 1);
+        la_show_matrix_d(stdout, x, n, 1, 1);
+        fprintf(stderr, "linear_solver: least squares of %ld equations, residual norm %g.\n",
+                equations, fabs(l[(size_t)n*t->ldw + n]));
+        free(x);
+    }
+    for (i=0; i < nthreads; i++)
+        free(t[i].w), free(t[i].tau);
+    free(t);
+    return ret;
+}
+
 main(argc, argv)
 char *argv[];
 {
-    double matrix[LA_SIZE][LA_SIZE];
+    la_matrix_d matrix;
     int rows, cols;
     int i,j,k;
     
     struct option long_opts[] = {
         {"help", no_argument, NULL, 'h'},
+        {"max-iterations", required_argument, NULL, 'i'},
+        {"method", required_argument, NULL, 'm'},
+        {"no-symbolic", no_argument, NULL, 'n'},
+        {"output-format", required_argument, NULL, 'o'},
         {"precision", required_argument, NULL, 'p'},
+        {"quiet", no_argument, NULL, 'q'},
+        {"restart", required_argument, NULL, 'r'},
+        {"rhs", required_argument, NULL, 'b'},
+        {"scratch", required_argument, NULL, 's'},
+        {"solution-only", no_argument, NULL, 'q'},
+        {"threads", required_argument, NULL, 't'},
+        {"tile", required_argument, NULL, 'T'},
+        {"tolerance", required_argument, NULL, 'e'},
         { 0 },
     };
-    int opt;
+    int opt, method;
+    int arg_quiet = 0;
+    char *arg_method = NULL;
+    char *arg_rhs = NULL;
+    double arg_tolerance = 1e-10;
+    int arg_max_iterations = 10000;
+    int arg_restart = 30;
+    int arg_threads = la_nprocs();
+    char *arg_scratch = NULL;
+    int arg_tile = 0;
 
-    for (; (opt = getopt_long(argc, argv, "p:", long_opts, NULL)) != -1;)
+    for (; (opt = getopt_long(argc, argv, "b:e:i:m:no:p:qr:s:t:T:", long_opts, NULL)) != -1;)
         switch (opt) {
+        case 'b':
+            arg_rhs = optarg;
+            break;
+        case 'e':
+            arg_tolerance = atof(optarg);
+            break;
+        case 'i':
+            arg_max_iterations = atoi(optarg);
+            break;
+        case 'm':
+            if (strcmp(optarg, "gauss-jordan") && strcmp(optarg, "lu") &&
+                strcmp(optarg, "cg") && strcmp(optarg, "gmres") &&
+                strcmp(optarg, "cholesky") && strcmp(optarg, "mixed") &&
+                strcmp(optarg, "least-squares")) {
+                fprintf(stderr, "linear_solver: invalid method '%s'.\n", optarg);
+                return 2;
+            }
+            arg_method = optarg;
+            break;
+        case 'n':
+            la_arg_symbolic = 0;
+            break;
+        case 'o':
+            if (la_parse_output_format(optarg)) {
+                fprintf(stderr, "linear_solver: invalid output format '%s'.\n", optarg);
+                return 2;
+            }
+            break;
         case 'p':
             la_arg_precision = atoi(optarg);
             break;
+        case 'q':
+            arg_quiet = 1;
+            break;
+        case 'r':
+            arg_restart = atoi(optarg);
+            break;
+        case 's':
+            arg_scratch = optarg;
+            break;
+        case 't':
+            arg_threads = atoi(optarg);
+            break;
+        case 'T':
+            arg_tile = atoi(optarg);
+            break;
         case '?':
             fputs("Try 'linear_solver --help' for more information.\n", stderr);
             return 2;
@@ -61,39 +565,124 @@ char *argv[];
                   "read as below:\n"
                   "1 1.5 3\n"
                   "8 18 30\n\n"
-                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n",
+                  "  -b, --rhs=FILE     read the right side of a sparse system from FILE\n"
+                  "  -e, --tolerance=TOL\n"
+                  "                     relative residual of the iterative methods, default is\n"
+                  "                     1e-10\n"
+                  "  -i, --max-iterations=NUM\n"
+                  "                     iterations of the iterative methods, default is 10000\n"
+                  "  -m, --method=NAME  gauss-jordan, lu (same as -q), cg (conjugate gradients),\n"
+                  "                     gmres, cholesky (sparse direct) or mixed (LU in float\n"
+                  "                     refined to double accuracy, reporting the iterations\n"
+                  "                     and the backward error) or least-squares (for more\n"
+                  "                     equations than unknowns); cg and cholesky are for\n"
+                  "                     symmetric positive definite systems; default is\n"
+                  "                     gauss-jordan, or gmres for sparse input\n"
+                  "  -n, --no-symbolic  print numbers without looking for known constants\n"
+                  "  -o, --output-format=FORMAT\n"
+                  "                     write matrices as text or bin (NumPy .npy), default is text\n"
+                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n"
+                  "  -q, --quiet, --solution-only\n"
+                  "                     solve by LU factorization with partial pivoting and print\n"
+                  "                     only the solution, one variable per line\n"
+                  "  -r, --restart=NUM  GMRES iterations between restarts, default is 30\n"
+                  "  -s, --scratch=FILE solve by LU out of core, with the matrix in FILE, for\n"
+                  "                     systems larger than memory; only the solution is printed\n"
+                  "  -t, --threads=NUM  threads of the factorizations and of the sparse products,\n"
+                  "                     default is the number of online processors\n"
+                  "  -T, --tile=NUM     order of the tiles of the LU factorization, default is 256,\n"
+                  "                     or columns of the out-of-core panels, default is 1024;\n"
+                  "                     three panels are kept in memory\n\n"
+                  "In quiet and mixed modes the matrix is factored once and every column at the\n"
+                  "right of the coefficients is a right side. More right sides can follow a\n"
+                  "line \"e\", one per line, and their solutions are printed one per line.\n\n"
+                  "A system in Matrix Market coordinate format is sparse, its right side may\n"
+                  "follow the entries or come from --rhs, else it is all ones. More sparse\n"
+                  "systems may follow, each right side ended by a line \"e\"; the ordering and\n"
+                  "symbolic analysis of cholesky are reused while the pattern repeats. Sparse\n"
+                  "methods print only the solution, one variable per line, and the solutions\n"
+                  "of a stream are separated by lines \"e\".\n\n"
+                  "The least-squares method minimizes ||A*x - b|| for [A | b] with any number\n"
+                  "of rows, up to a line \"e\". The rows are read in chunks, split among the\n"
+                  "threads and folded into a triangular factor by Householder QR, with memory\n"
+                  "for the factor and a chunk only. Only the solution is printed, and the norm\n"
+                  "of the residual goes to standard error.\n",
                   stdout);
             return 0;
         }
 
-    la_read_one_pointer_matrix_d(stdin, matrix, &rows, &cols);
-    puts("Linear System:");
-    la_show_pointer_matrix_d(stdout, matrix, rows, cols);
+    if (arg_scratch)
+        return ooc_solve(arg_scratch, arg_tile, arg_threads);
+    if (arg_method && !strcmp(arg_method, "least-squares"))
+        return lsq_solve(arg_threads);
+    method = !arg_method || !strcmp(arg_method, "gmres")? METHOD_GMRES :
+             !strcmp(arg_method, "cg")? METHOD_CG :
+             !strcmp(arg_method, "cholesky")? METHOD_CHOLESKY : -1;
+    if (la_peek(stdin) == '%') {
+        if (method == -1) {
+            fputs("linear_solver: sparse input needs method cg, gmres or cholesky.\n", stderr);
+            return 2;
+        }
+        for (i=0; la_peek(stdin) == '%'; i++) {
+            if (i && !la_arg_binary)
+                puts("e");
+            if (sparse_solve(NULL, method, arg_rhs, arg_tolerance,
+                             arg_max_iterations, arg_restart, arg_threads))
+                return 1;
+        }
+        return 0;
+    }
+    la_allocate_matrix_d(&matrix, 0, 0);
+    la_read_matrix_d(stdin, &matrix);
+    if (arg_method && method != -1) {
+        i = sparse_solve(&matrix, method, arg_rhs, arg_tolerance,
+                         arg_max_iterations, arg_restart, arg_threads);
+        la_free_matrix_d(&matrix);
+        return i;
+    }
+    if (arg_quiet || (arg_method && (!strcmp(arg_method, "lu") ||
+                                     !strcmp(arg_method, "mixed")))) {
+        i = lu_solve(&matrix, arg_method && !strcmp(arg_method, "mixed"),
+                     arg_tile, arg_threads);
+        la_free_matrix_d(&matrix);
+        return i;
+    }
+    rows = matrix.rows;
+    cols = matrix.cols;
+    /* Only the solution is written in binary. */
+    if (!la_arg_binary) {
+        puts("Linear System:");
+        la_show_matrix_d(stdout, matrix.base, rows, cols, matrix.lda);
+    }
     for (k=0; k < rows; k++) {
         for (i=k+1; i < cols; i++)
-            matrix[k][i] /= matrix[k][k];
-        matrix[k][k] = 1.f;
+            LA_AT(&matrix, k, i) /= LA_AT(&matrix, k, k);
+        LA_AT(&matrix, k, k) = 1.f;
         for (i=k+1; i < rows; i++) {
             for (j=k+1; j < cols; j++)
-                matrix[i][j] -= matrix[k][j]*matrix[i][k];
-            matrix[i][k] = 0;
+                LA_AT(&matrix, i, j) -= LA_AT(&matrix, k, j)*LA_AT(&matrix, i, k);
+            LA_AT(&matrix, i, k) = 0;
+        }
+        if (!la_arg_binary) {
+            printf("Step %0d:\n", k+1);
+            la_show_matrix_d(stdout, matrix.base, rows, cols, matrix.lda);
         }
-        printf("Step %0d:\n", k+1);
-        la_show_pointer_matrix_d(stdout, matrix, rows, cols);
     }
     if (rows+1==cols)
         for (k=rows-2; k >= 0; k--)
             for (i=k; i < rows-1; i++) {
-                matrix[k][cols-1] -= matrix[i+1][cols-1]*matrix[k][i+1];
-                matrix[k][i+1] = 0;
+                LA_AT(&matrix, k, cols-1) -= LA_AT(&matrix, i+1, cols-1)*LA_AT(&matrix, k, i+1);
+                LA_AT(&matrix, k, i+1) = 0;
             }
     else
         for (k=rows-1; k > 0; k--)    
             for (i=k-1; i >= 0; i--) {
                 for (j=k+1; j < cols; j++)
-                    matrix[i][j] -= matrix[i][k]*matrix[k][j];
-                matrix[i][k] = 0;
+                    LA_AT(&matrix, i, j) -= LA_AT(&matrix, i, k)*LA_AT(&matrix, k, j);
+                LA_AT(&matrix, i, k) = 0;
             }
-    puts("Solution:");
-    la_show_pointer_matrix_d(stdout, matrix, rows, cols);
+    if (!la_arg_binary)
+        puts("Solution:");
+    la_show_matrix_d(stdout, matrix.base, rows, cols, matrix.lda);
+    la_free_matrix_d(&matrix);
 }
@@ -1,9 +1,16 @@
 /*
-    matmul - v2.0.0
+    matmul - v2.6.0
     Do matrix multiplication.
     Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
     
     History:
+        v2.6.0  Threads and stats arguments
+        v2.5.0  BLAS argument, built-in or system GEMM
+        v2.4.0  Stream of matrix pairs, multiplied in batches of the same shape,
+                and C no longer accumulated over uninitialized memory
+        v2.3.0  Output format argument
+        v2.2.0  No symbolic argument
+        v2.1.0  Heap-allocated matrices of any size
         v2.0.0  Printing precision argument and remove last space in output
         v1.0.1  stream and lda argument in la_read_matrices_d and stream arg in
                 la_show_matrix_d
@@ -22,47 +29,183 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include <getopt.h>
 
-#include <cblas.h>
-
 #include "linear_algebra.h"
 
 
+/* Most pairs of the same shape multiplied at once. */
+#define MATMUL_BATCH 64
+
+/* Stacked operands of a batch: count pairs of m x k and k x n matrices. */
+struct batch {
+    la_matrix_d a, b, c;
+    int count, m, n, k;
+    int nthreads;
+    double seconds, flops;
+};
+
+double seconds()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Append the rows of m to s, which holds count matrices with m->rows rows. */
+static void stack(s, m, count)
+la_matrix_d *s, *m;
+{
+    int i;
+
+    la_resize_matrix_d(s, (count+1) * m->rows, m->cols);
+    for (i=0; i < m->rows; i++)
+        memcpy(&LA_AT(s, count*m->rows + i, 0), &LA_AT(m, i, 0),
+               sizeof(double) * m->cols);
+}
+
+/* Multiply the pairs of the batch and print the products in order, separated
+ * by "e" lines in text so that the output can be read back as a stream. */
+static void flush(bt, shown)
+struct batch *bt;
+int *shown;
+{
+    int p;
+    double t;
+
+    if (!bt->count)
+        return;
+    la_resize_matrix_d(&bt->c, bt->count * bt->m, bt->n);
+    t = seconds();
+    la_gemm_batch_d(bt->count, bt->m, bt->n, bt->k,
+                    bt->a.base, bt->a.lda, (size_t)bt->m * bt->a.lda,
+                    bt->b.base, bt->b.lda, (size_t)bt->k * bt->b.lda,
+                    bt->c.base, bt->c.lda, (size_t)bt->m * bt->c.lda,
+                    bt->nthreads);
+    bt->seconds += seconds() - t;
+    bt->flops += 2.0 * bt->count * bt->m * bt->n * bt->k;
+    for (p=0; p < bt->count; p++, ++*shown) {
+        if (*shown && !la_arg_binary)
+            puts("e");
+        la_show_matrix_d(stdout, &LA_AT(&bt->c, p * bt->m, 0), bt->m, bt->n,
+                         bt->c.lda);
+    }
+    bt->count = 0;
+    bt->a.rows = bt->b.rows = 0;
+}
+
 main(argc, argv)
 char *argv[];
 {
-    double a[LA_SIZE*LA_SIZE], b[LA_SIZE*LA_SIZE], c[LA_SIZE*LA_SIZE];
-    int rows_a, cols_a, rows_b, cols_b;
+    la_matrix_d a, b;
+    struct batch bt;
+    int shown, ret;
 
     struct option long_opts[] = {
+        {"blas", required_argument, NULL, 'b'},
         {"help", no_argument, NULL, 'h'},
+        {"no-symbolic", no_argument, NULL, 'n'},
+        {"output-format", required_argument, NULL, 'o'},
         {"precision", required_argument, NULL, 'p'},
+        {"stats", no_argument, NULL, 's'},
+        {"threads", required_argument, NULL, 't'},
         { 0 },
     };
     int opt;
+    int arg_stats = 0;
+    int arg_threads = la_nprocs();
 
-    for (; (opt = getopt_long(argc, argv, "p:", long_opts, NULL)) != -1;)
+    for (; (opt = getopt_long(argc, argv, "b:no:p:st:", long_opts, NULL)) != -1;)
         switch (opt) {
+        case 'b':
+            if (la_parse_blas(optarg)) {
+                fprintf(stderr, "matmul: invalid BLAS '%s'.\n", optarg);
+                return 2;
+            }
+            break;
+        case 'n':
+            la_arg_symbolic = 0;
+            break;
+        case 'o':
+            if (la_parse_output_format(optarg)) {
+                fprintf(stderr, "matmul: invalid output format '%s'.\n", optarg);
+                return 2;
+            }
+            break;
         case 'p':
             la_arg_precision = atoi(optarg);
             break;
+        case 's':
+            arg_stats = 1;
+            break;
+        case 't':
+            arg_threads = atoi(optarg);
+            break;
         case '?':
             fputs("Try 'matmul --help' for more information.\n", stderr);
             return 2;
         case 'h':
             fputs("Usage: matmul [OPTION]\n"
                   "Do matrix multiplication.\n\n"
-                  "The matrices are read from standard input.\n\n"
-                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n",
+                  "The matrices are read from standard input, each one ended by a line \"e\".\n"
+                  "Any number of pairs may follow, the product of each pair is printed and\n"
+                  "the products are separated by lines \"e\".\n\n"
+                  "  -b, --blas=NAME    use the internal or system GEMM, default is system\n"
+                  "  -n, --no-symbolic  print numbers without looking for known constants\n"
+                  "  -o, --output-format=FORMAT\n"
+                  "                     write matrices as text or bin (NumPy .npy), default is text\n"
+                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n"
+                  "  -s, --stats        print the time and GFLOP/s of the products to standard\n"
+                  "                     error\n"
+                  "  -t, --threads=NUM  number of threads, default is the number of online\n"
+                  "                     processors, each one pinned to a processor\n",
                   stdout);
             return 0;
         }
 
-    la_read_matrices_d(stdin, a, &rows_a, &cols_a, LA_SIZE);
-    la_read_matrices_d(stdin, b, &rows_b, &cols_b, LA_SIZE);
-    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, rows_a, cols_b,
-                cols_a, 1.f, a, LA_SIZE, b, LA_SIZE, 1.f, c, LA_SIZE);
-    la_show_matrix_d(stdout, c, rows_a, cols_b, LA_SIZE);
+    la_allocate_matrix_d(&a, 0, 0);
+    la_allocate_matrix_d(&b, 0, 0);
+    la_allocate_matrix_d(&bt.a, 0, 0);
+    la_allocate_matrix_d(&bt.b, 0, 0);
+    la_allocate_matrix_d(&bt.c, 0, 0);
+    bt.count = shown = ret = 0;
+    bt.nthreads = arg_threads;
+    bt.seconds = bt.flops = 0;
+    la_arg_pin = arg_threads > 1;
+    for (;;) {
+        la_read_matrix_d(stdin, &a);
+        if (!a.rows)
+            break;
+        la_read_matrix_d(stdin, &b);
+        if (a.cols != b.rows) {
+            fprintf(stderr, "matmul: cannot multiply %d x %d by %d x %d matrix.\n",
+                    a.rows, a.cols, b.rows, b.cols);
+            ret = 1;
+            break;
+        }
+        if (bt.count == MATMUL_BATCH ||
+            (bt.count && (a.rows != bt.m || a.cols != bt.k || b.cols != bt.n)))
+            flush(&bt, &shown);
+        bt.m = a.rows;
+        bt.k = a.cols;
+        bt.n = b.cols;
+        stack(&bt.a, &a, bt.count);
+        stack(&bt.b, &b, bt.count);
+        bt.count++;
+    }
+    flush(&bt, &shown);
+    if (arg_stats)
+        fprintf(stderr, "matmul: %d products, %.3lf GFLOP in %.6lf s, %.2lf GFLOP/s with %d threads\n",
+                shown, bt.flops / 1e9, bt.seconds,
+                bt.seconds? bt.flops / bt.seconds / 1e9 : 0, arg_threads);
+    la_free_matrix_d(&a);
+    la_free_matrix_d(&b);
+    la_free_matrix_d(&bt.a);
+    la_free_matrix_d(&bt.b);
+    la_free_matrix_d(&bt.c);
+    return ret;
 }
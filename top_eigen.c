@@ -0,0 +1,329 @@
+/*
+    top_eigen - v1.0.0
+    Finds the dominant eigenvalues or singular values of a matrix.
+    Copyright (C) 2025  João Manica  <joaoedisonmanica@gmail.com>
+
+    History:
+        v1.0.0  First version
+
+    top_eigen is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or any later version.
+
+    This program is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <math.h>
+#include <float.h>
+
+#include <getopt.h>
+
+#include "cblas.h"
+
+#include "linear_algebra.h"
+
+
+/* Rows of a Krylov block beyond the values asked for. */
+#define OVERSAMPLING 10
+
+/* Tries of random rows in place of a block that lost rank. */
+#define MAX_REFILL 3
+
+static unsigned short random_state[3];
+
+/* Standard normal numbers by Box-Muller. */
+static void gaussian(x, n)
+double *x;
+size_t n;
+{
+    size_t i;
+    double r, t;
+
+    for (i=0; i < n; i += 2) {
+        r = sqrt(-2 * log(1 - erand48(random_state)));
+        t = 2 * M_PI * erand48(random_state);
+        x[i] = r * cos(t);
+        if (i+1 < n)
+            x[i+1] = r * sin(t);
+    }
+}
+
+/* Make the r rows of y, of length n, orthonormal and orthogonal to the k
+ * rows of basis: project them out twice, then Householder LQ. Rows that
+ * become dependent are replaced by random ones. */
+static void orthonormalize(basis, k, y, r, n, nthreads)
+double *basis, *y;
+{
+    double *c, *tau, *copy, scale, norm;
+    int i, pass, tries, refill;
+
+    c = malloc(sizeof(double) * ((size_t)r * k + 1));
+    tau = malloc(sizeof(double) * r);
+    copy = malloc(sizeof(double) * (size_t)r * n);
+    for (tries=0; ; tries++) {
+        for (scale=i=0; i < r; i++)
+            if ((norm = cblas_dnrm2(n, y + (size_t)i*n, 1)) > scale)
+                scale = norm;
+        for (pass=0; k && pass < 2; pass++) {
+            cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, r, k, n, 1.0,
+                        y, n, basis, n, 0.0, c, k);
+            cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, r, n, k,
+                        -1.0, c, k, basis, n, 1.0, y, n);
+        }
+        memcpy(copy, y, sizeof(double) * (size_t)r * n);
+        la_gelqf_d(r, n, y, n, tau, nthreads);
+        /* Row i depends on the basis and the rows above it when L(i,i) is
+         * small; the others are kept. */
+        for (refill=i=0; i < r; i++)
+            if (!(fabs(y[(size_t)i*n + i]) > n * DBL_EPSILON * scale)) {
+                gaussian(copy + (size_t)i*n, n);
+                refill = 1;
+            }
+        if (!refill || tries == MAX_REFILL)
+            break;
+        memcpy(y, copy, sizeof(double) * (size_t)r * n);
+    }
+    la_orglq_d(r, n, y, n, tau, nthreads);
+    free(c), free(tau), free(copy);
+}
+
+/* y = x*A for the r rows of x, or x*A^T*A with singular, z of r x m. */
+static void apply(a, singular, x, r, y, z, nthreads)
+la_matrix_d *a;
+double *x, *y, *z;
+{
+    int m, n;
+
+    m = a->rows, n = a->cols;
+    if (singular) {
+        la_gemm_parallel_d(1, r, m, n, 1.0, x, n, a->base, a->lda, 0.0, z, m,
+                           nthreads);
+        la_gemm_parallel_d(0, r, n, m, 1.0, z, m, a->base, a->lda, 0.0, y, n,
+                           nthreads);
+    } else
+        la_gemm_parallel_d(0, r, n, n, 1.0, x, n, a->base, a->lda, 0.0, y, n,
+                           nthreads);
+}
+
+/* The count eigenvalues of largest magnitude of the symmetric a, or its
+ * count largest singular values, in the first column of out, and with
+ * vectors their eigenvectors or right singular vectors at their right.
+ *
+ * The basis of a block Krylov space is built from the range of a block of
+ * random rows, each block the previous one times A (A^T*A for singular
+ * values) made orthonormal to all the others. Its Rayleigh quotient, of
+ * order count+OVERSAMPLING times depth+1 at most, gives the values. Return
+ * the rows of out. */
+top(a, count, depth, singular, vectors, out, ldo, nthreads)
+la_matrix_d *a;
+double *out;
+{
+    double *basis, *w, *z, *t, *theta, *u, *x, max;
+    int m, n, b, s, r, next, start, i, j, *order;
+
+    m = a->rows, n = a->cols;
+    if (count > n)
+        count = n;
+    b = count + OVERSAMPLING < n? count + OVERSAMPLING : n;
+    s = (double)b * (depth+1) < n? b * (depth+1) : n;
+    basis = malloc(sizeof(double) * ((size_t)s * n + 1));
+    w = malloc(sizeof(double) * ((size_t)s * n + 1));
+    z = malloc(sizeof(double) * ((size_t)b * (singular? m : n) + 1));
+    /* Range of a random block: the first block is omega*A. */
+    gaussian(z, (size_t)b * (singular? m : n));
+    if (singular)
+        la_gemm_parallel_d(0, b, n, m, 1.0, z, m, a->base, a->lda, 0.0, basis,
+                           n, nthreads);
+    else
+        la_gemm_parallel_d(0, b, n, n, 1.0, z, n, a->base, a->lda, 0.0, basis,
+                           n, nthreads);
+    orthonormalize(basis, 0, basis, b, n, nthreads);
+    /* Block Lanczos, with the products of every block kept in w for the
+     * Rayleigh quotient. */
+    for (start=0; start < s; start += r) {
+        r = s - start < b? s - start : b;
+        apply(a, singular, basis + (size_t)start*n, r, w + (size_t)start*n, z,
+              nthreads);
+        if ((next = s - start - r) > b)
+            next = b;
+        if (next) {
+            memcpy(basis + (size_t)(start+r)*n, w + (size_t)start*n,
+                   sizeof(double) * next * n);
+            orthonormalize(basis, start+r, basis + (size_t)(start+r)*n, next,
+                           n, nthreads);
+        }
+    }
+    /* T = K*A*K^T and its eigenvectors u, the Ritz vectors u*K. */
+    t = malloc(sizeof(double) * s * s);
+    u = malloc(sizeof(double) * s * s);
+    theta = malloc(sizeof(double) * s);
+    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, s, s, n, 1.0, w, n,
+                basis, n, 0.0, t, s);
+    for (i=0; i < s; i++)
+        for (j=0; j < i; j++)
+            t[i*s + j] = t[j*s + i] = (t[i*s + j] + t[j*s + i]) / 2;
+    if (la_syev_jacobi_d(s, t, s, theta, u, s))
+        fputs("top_eigen: the Rayleigh quotient did not converge.\n", stderr);
+    /* Decreasing order of magnitude: from both ends of theta. */
+    order = malloc(sizeof(int) * s);
+    for (r=i=0, j=s-1; i <= j; r++)
+        if (singular || theta[i] >= -theta[j])
+            order[r] = i++;
+        else
+            order[r] = j--;
+    x = malloc(sizeof(double) * n);
+    for (i=0; i < count; i++) {
+        out[(size_t)i*ldo] = singular? sqrt(fmax(theta[order[i]], 0)) :
+                                       theta[order[i]];
+        if (!vectors)
+            continue;
+        cblas_dgemv(CblasRowMajor, CblasTrans, s, n, 1.0, basis, n,
+                    u + (size_t)order[i]*s, 1, 0.0, x, 1);
+        /* The sign that makes the largest component positive. */
+        for (max=j=0; j < n; j++)
+            if (fabs(x[j]) > fabs(max))
+                max = x[j];
+        for (j=0; j < n; j++)
+            out[(size_t)i*ldo + 1+j] = max < 0? -x[j] : x[j];
+    }
+    free(basis), free(w), free(z), free(t), free(u), free(theta), free(order);
+    free(x);
+    return count;
+}
+
+main(argc, argv)
+char *argv[];
+{
+    la_matrix_d matrix, out;
+    double max;
+    int i, j, rows;
+
+    struct option long_opts[] = {
+        {"count", required_argument, NULL, 'k'},
+        {"depth", required_argument, NULL, 'd'},
+        {"help", no_argument, NULL, 'h'},
+        {"no-symbolic", no_argument, NULL, 'n'},
+        {"output-format", required_argument, NULL, 'o'},
+        {"precision", required_argument, NULL, 'p'},
+        {"seed", required_argument, NULL, 'S'},
+        {"singular", no_argument, NULL, 's'},
+        {"threads", required_argument, NULL, 't'},
+        {"vectors", no_argument, NULL, 'v'},
+        { 0 },
+    };
+    int opt;
+    int arg_count = 1;
+    int arg_depth = 8;
+    long arg_seed = 1;
+    int arg_singular = 0;
+    int arg_threads = la_nprocs();
+    int arg_vectors = 0;
+
+    for (; (opt = getopt_long(argc, argv, "d:k:no:p:sS:t:v", long_opts, NULL)) != -1;)
+        switch (opt) {
+        case 'd':
+            arg_depth = atoi(optarg);
+            break;
+        case 'k':
+            arg_count = atoi(optarg);
+            break;
+        case 'n':
+            la_arg_symbolic = 0;
+            break;
+        case 'o':
+            if (la_parse_output_format(optarg)) {
+                fprintf(stderr, "top_eigen: invalid output format '%s'.\n", optarg);
+                return 2;
+            }
+            break;
+        case 'p':
+            la_arg_precision = atoi(optarg);
+            break;
+        case 's':
+            arg_singular = 1;
+            break;
+        case 'S':
+            arg_seed = atol(optarg);
+            break;
+        case 't':
+            arg_threads = atoi(optarg);
+            break;
+        case 'v':
+            arg_vectors = 1;
+            break;
+        case '?':
+            fputs("Try 'top_eigen --help' for more information.\n", stderr);
+            return 2;
+        case 'h':
+            fputs("Usage: top_eigen [OPTION]\n"
+                  "Finds the dominant eigenvalues or singular values of a matrix.\n\n"
+                  "The matrix is read from standard input, symmetric for eigenvalues. The\n"
+                  "values are found by block Lanczos from the range of random vectors, in\n"
+                  "O(n^2*k) time, one per line in decreasing order of magnitude.\n\n"
+                  "  -d, --depth=NUM    Krylov blocks after the first one, default is 8; more\n"
+                  "                     are more accurate for close values\n"
+                  "  -k, --count=NUM    number of values, default is 1\n"
+                  "  -n, --no-symbolic  print numbers without looking for known constants\n"
+                  "  -o, --output-format=FORMAT\n"
+                  "                     write matrices as text or bin (NumPy .npy), default is text\n"
+                  "  -p, --precision    printing precision of floating-point numbers, default is 6\n"
+                  "  -s, --singular     singular values of any matrix instead of eigenvalues\n"
+                  "  -S, --seed=NUM     seed of the random vectors, default is 1\n"
+                  "  -t, --threads=NUM  number of threads, default is the number of online\n"
+                  "                     processors\n"
+                  "  -v, --vectors      print after each value its eigenvector, or its right\n"
+                  "                     singular vector\n",
+                  stdout);
+            return 0;
+        }
+
+    if (arg_count < 1 || arg_depth < 0) {
+        fputs("top_eigen: the count must be positive and the depth not negative.\n", stderr);
+        return 2;
+    }
+    random_state[0] = 0x330e;
+    random_state[1] = arg_seed;
+    random_state[2] = arg_seed >> 16;
+    la_allocate_matrix_d(&matrix, 0, 0);
+    la_read_matrix_d(stdin, &matrix);
+    if (!matrix.rows || !matrix.cols) {
+        fputs("top_eigen: empty matrix.\n", stderr);
+        return 1;
+    }
+    if (!arg_singular) {
+        if (matrix.rows != matrix.cols) {
+            fputs("top_eigen: the matrix is not square, try --singular.\n", stderr);
+            return 1;
+        }
+        /* Round-off is relative to the largest entry, not to each pair:
+         * entries near zero may differ by much more than themselves. */
+        for (max=i=0; i < matrix.rows; i++)
+            for (j=0; j < matrix.cols; j++)
+                max = fmax(max, fabs(LA_AT(&matrix, i, j)));
+        for (i=0; i < matrix.rows; i++)
+            for (j=0; j < i; j++) {
+                if (fabs(LA_AT(&matrix, i, j) - LA_AT(&matrix, j, i)) >
+                    64 * DBL_EPSILON * matrix.rows * max) {
+                    fputs("top_eigen: the matrix is not symmetric, try --singular.\n", stderr);
+                    return 1;
+                }
+                /* The products use the rows only: (A + A^T)/2. */
+                LA_AT(&matrix, i, j) = LA_AT(&matrix, j, i) =
+                    (LA_AT(&matrix, i, j) + LA_AT(&matrix, j, i)) / 2;
+            }
+    }
+    la_allocate_matrix_d(&out, arg_count, 1 + (arg_vectors? matrix.cols : 0));
+    rows = top(&matrix, arg_count, arg_depth, arg_singular, arg_vectors,
+               out.base, out.lda, arg_threads);
+    la_show_matrix_d(stdout, out.base, rows, out.cols, out.lda);
+    la_free_matrix_d(&out);
+    la_free_matrix_d(&matrix);
+    return 0;
+}